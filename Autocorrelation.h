@@ -0,0 +1,196 @@
+//
+// Created by chris on 17.10.26.
+//
+#pragma once
+
+#include <cmath>
+#include <complex>
+#include <numbers>
+#include <numeric>
+#include <vector>
+
+#include "ThreadPool.h"
+
+/**
+ * Radix-2 fast Fourier transform of a fixed power-of-two size. The bit reversal and the roots of unity are computed
+ * once, so one plan transforms any number of series.
+ */
+class FftPlan {
+public:
+    explicit FftPlan(size_t size) : size(size), reversed(size), roots(size / 2) {
+        unsigned int bits = 0;
+        while ((size_t(1) << bits) < size) {
+            ++bits;
+        }
+        // the reversal of i is the one of i / 2 shifted, with the lowest bit of i on top
+        for (size_t i = 1; i < size; ++i) {
+            reversed[i] = (reversed[i >> 1] >> 1) | ((i & 1) << (bits - 1));
+        }
+        for (size_t k = 0; k < roots.size(); ++k) {
+            roots[k] = std::polar(1.0, -2 * std::numbers::pi * static_cast<double>(k) / static_cast<double>(size));
+        }
+    }
+
+    [[nodiscard]] size_t getSize() const {
+        return size;
+    }
+
+    /**
+     * transforms data of getSize() elements in place, the inverse transform is not divided by the size
+     */
+    void transform(std::vector<std::complex<double>> &data, bool inverse) const {
+        for (size_t i = 0; i < size; ++i) {
+            if (i < reversed[i]) {
+                std::swap(data[i], data[reversed[i]]);
+            }
+        }
+        for (size_t length = 2; length <= size; length *= 2) {
+            const size_t half = length / 2;
+            const size_t stride = size / length;
+            for (size_t begin = 0; begin < size; begin += length) {
+                for (size_t k = 0; k < half; ++k) {
+                    const auto &root = roots[k * stride];
+                    const double im = inverse ? -root.imag() : root.imag();
+                    // written out, std::complex multiplies with checks for infinities
+                    const auto &value = data[begin + k + half];
+                    const std::complex<double> odd(value.real() * root.real() - value.imag() * im,
+                                                   value.real() * im + value.imag() * root.real());
+                    data[begin + k + half] = data[begin + k] - odd;
+                    data[begin + k] += odd;
+                }
+            }
+        }
+    }
+
+private:
+    size_t size;
+    std::vector<size_t> reversed;
+    // exp(-2 pi i k / size)
+    std::vector<std::complex<double>> roots;
+};
+
+/**
+ * Autocorrelation of one or two real series at once: a goes to the real part, b to the imaginary part of one
+ * complex transform. The data is zero padded to twice the length, so the cyclic correlation of the transform has
+ * no wraparound. rho(t) = sum_(i < n-t) x_i x_(i+t) / sum_(i < n-t) x_i², with x the deviations from the mean.
+ */
+template<typename T>
+void autocorrelationOfPair(const std::vector<T> &a, const std::vector<T> *b, const FftPlan &plan,
+                           std::vector<double> &resultA, std::vector<double> *resultB) {
+    const size_t size = plan.getSize();
+    std::vector<std::complex<double>> data(size);
+    auto deviations = [](const std::vector<T> &values) {
+        const double mean = std::accumulate(values.begin(), values.end(), 0.0) /
+                            static_cast<double>(values.size());
+        std::vector<double> x(values.size());
+        for (size_t i = 0; i < values.size(); ++i) {
+            x[i] = static_cast<double>(values[i]) - mean;
+        }
+        return x;
+    };
+    const std::vector<double> x = deviations(a);
+    const std::vector<double> y = b == nullptr ? std::vector<double>() : deviations(*b);
+    for (size_t i = 0; i < x.size(); ++i) {
+        data[i].real(x[i]);
+    }
+    for (size_t i = 0; i < y.size(); ++i) {
+        data[i].imag(y[i]);
+    }
+    plan.transform(data, false);
+    // split the spectra of the two real series and take their power, both are real and even
+    std::vector<std::complex<double>> power(size);
+    for (size_t k = 0; k < size; ++k) {
+        const auto z = data[k];
+        const auto mirrored = std::conj(data[(size - k) % size]);
+        const auto spectrumA = (z + mirrored) * 0.5;
+        const auto spectrumB = (z - mirrored) * std::complex<double>(0, -0.5);
+        power[k] = {std::norm(spectrumA), std::norm(spectrumB)};
+    }
+    plan.transform(power, true);
+
+    auto normalize = [size, &power](const std::vector<double> &deviation, std::vector<double> &result, bool imag) {
+        const size_t n = deviation.size();
+        // sums of the squares of the first k deviations, the denominator of lag t is squares[n - t]
+        std::vector<double> squares(n + 1, 0);
+        for (size_t i = 0; i < n; ++i) {
+            squares[i + 1] = squares[i] + deviation[i] * deviation[i];
+        }
+        result.assign(n / 2, 0);
+        for (size_t t = 0; t < result.size(); ++t) {
+            const double numerator = (imag ? power[t].imag() : power[t].real()) / static_cast<double>(size);
+            result[t] = squares[n - t] > 0 ? numerator / squares[n - t] : 0;
+        }
+    };
+    normalize(x, resultA, false);
+    if (resultB != nullptr) {
+        normalize(y, *resultB, true);
+    }
+}
+
+// smallest power of two to hold the series and its zero padding
+inline size_t paddedFftSize(size_t length) {
+    size_t size = 1;
+    while (size < 2 * length) {
+        size *= 2;
+    }
+    return size;
+}
+
+/**
+ * Autocorrelation function of a series with the FFT in O(n log n), accumulated in double.
+ * @return rho(t) for the lags t = 0 ... n/2 - 1, rho(t) = sum_(i < n-t) x_i x_(i+t) / sum_(i < n-t) x_i² with x the
+ * deviations from the mean. 0 where the series is constant.
+ */
+template<typename T>
+std::vector<double> autocorrelation(const std::vector<T> &values) {
+    std::vector<double> result;
+    if (values.size() < 2) {
+        return result;
+    }
+    const FftPlan plan(paddedFftSize(values.size()));
+    autocorrelationOfPair<T>(values, nullptr, plan, result, nullptr);
+    return result;
+}
+
+/**
+ * autocorrelation of every series, like autocorrelation. Two series of the same length share one complex transform,
+ * the pairs run in parallel on the given pool.
+ */
+template<typename T>
+std::vector<std::vector<double>> autocorrelations(const std::vector<std::vector<T>> &series,
+                                                  ThreadPool &pool = sharedPool()) {
+    std::vector<std::vector<double>> results(series.size());
+    // pairs of indices of series with the same length, the last one of an odd count alone
+    std::vector<std::pair<size_t, size_t>> pairs;
+    std::vector<bool> paired(series.size(), false);
+    for (size_t i = 0; i < series.size(); ++i) {
+        if (paired[i] || series[i].size() < 2) {
+            continue;
+        }
+        paired[i] = true;
+        size_t partner = series.size();
+        for (size_t j = i + 1; j < series.size() && partner == series.size(); ++j) {
+            if (!paired[j] && series[j].size() == series[i].size()) {
+                partner = j;
+            }
+        }
+        if (partner != series.size()) {
+            paired[partner] = true;
+        }
+        pairs.emplace_back(i, partner);
+    }
+
+    TaskGroup group(pool);
+    for (const auto &[first, second] : pairs) {
+        group.submit([&series, &results, first = first, second = second]() {
+            const FftPlan plan(paddedFftSize(series[first].size()));
+            if (second == series.size()) {
+                autocorrelationOfPair<T>(series[first], nullptr, plan, results[first], nullptr);
+            } else {
+                autocorrelationOfPair<T>(series[first], &series[second], plan, results[first], &results[second]);
+            }
+        });
+    }
+    group.wait();
+    return results;
+}
@@ -0,0 +1,158 @@
+//
+// Created by chris on 17.10.26.
+//
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * storage of a JointHistogram, Auto is dense for lattices with at most denseCellLimit (bond sum, spin sum) pairs
+ */
+enum class HistogramStorage {
+    Auto,
+    Dense,
+    Sparse
+};
+
+/**
+ * number of measurements with one (bond sum, spin sum)
+ */
+struct HistogramEntry {
+    long long bondSum;
+    long long spinSum;
+    std::uint64_t count;
+};
+
+/**
+ * Joint histogram of the exact bond and spin sums of the measurements of a lattice with N² spins. The 2N² bonds
+ * and N² spins are ±1 each, so the bond sum is even and the spin sum has the parity of N²: there are 2N² + 1 bond sums
+ * and N² + 1 spin sums. The energy and magnetization of every measurement and every moment of them follow exactly from
+ * the histogram, its size doesn't grow with the number of measurements.
+ *
+ * Dense stores a count for every possible pair, (2N² + 1)(N² + 1) cells, only feasible for small lattices. Sparse
+ * stores the visited pairs in a hash map, at equilibrium only a small part of the plane around the mean.
+ */
+class JointHistogram {
+public:
+    static constexpr std::uint64_t denseCellLimit = 1 << 18;
+
+    explicit JointHistogram(unsigned int sights = 0, HistogramStorage storage = HistogramStorage::Auto)
+            : sights(sights), numOfSpins(static_cast<long long>(sights) * sights), total(0) {
+        const auto cells = static_cast<std::uint64_t>(2 * numOfSpins + 1) * static_cast<std::uint64_t>(numOfSpins + 1);
+        dense = storage == HistogramStorage::Dense || (storage == HistogramStorage::Auto && cells <= denseCellLimit);
+        if (dense) {
+            cellCounts.assign(cells, 0);
+        }
+    }
+
+    void add(long long bondSum, long long spinSum) {
+        add(bondSum, spinSum, 1);
+    }
+
+    void add(long long bondSum, long long spinSum, std::uint64_t count) {
+        addCell(cell(bondSum, spinSum), count);
+    }
+
+    /**
+     * adds all measurements of another histogram of the same lattice size, the storage of both may differ
+     * @param multiplicity every measurement of other is added this often, e.g. for a bootstrap replica. The counts are
+     * 64 bit, so the products don't overflow.
+     */
+    void merge(const JointHistogram &other, std::uint32_t multiplicity = 1) {
+        if (multiplicity == 0) {
+            return;
+        }
+        if (other.dense) {
+            for (std::uint64_t i = 0; i < other.cellCounts.size(); ++i) {
+                if (other.cellCounts[i] != 0) {
+                    addCell(i, other.cellCounts[i] * std::uint64_t{multiplicity});
+                }
+            }
+        } else {
+            for (const auto &[i, count] : other.sparseCounts) {
+                addCell(i, count * std::uint64_t{multiplicity});
+            }
+        }
+    }
+
+    [[nodiscard]] unsigned int getSights() const {
+        return sights;
+    }
+
+    [[nodiscard]] bool isDense() const {
+        return dense;
+    }
+
+    /**
+     * @return number of measurements
+     */
+    [[nodiscard]] std::uint64_t getCount() const {
+        return total;
+    }
+
+    /**
+     * @return number of different (bond sum, spin sum) of the measurements
+     */
+    [[nodiscard]] size_t getNumOfBins() const {
+        if (!dense) {
+            return sparseCounts.size();
+        }
+        return static_cast<size_t>(std::count_if(cellCounts.begin(), cellCounts.end(),
+                                                 [](std::uint64_t count) { return count != 0; }));
+    }
+
+    /**
+     * @return every visited (bond sum, spin sum), sorted by bond sum and then by spin sum
+     */
+    [[nodiscard]] std::vector<HistogramEntry> getEntries() const {
+        std::vector<HistogramEntry> entries;
+        if (dense) {
+            for (std::uint64_t i = 0; i < cellCounts.size(); ++i) {
+                if (cellCounts[i] != 0) {
+                    entries.push_back(entry(i, cellCounts[i]));
+                }
+            }
+            return entries;
+        }
+        entries.reserve(sparseCounts.size());
+        for (const auto &[i, count] : sparseCounts) {
+            entries.push_back(entry(i, count));
+        }
+        std::sort(entries.begin(), entries.end(), [](const HistogramEntry &a, const HistogramEntry &b) {
+            return a.bondSum != b.bondSum ? a.bondSum < b.bondSum : a.spinSum < b.spinSum;
+        });
+        return entries;
+    }
+
+private:
+    // the cells are ordered by bond sum, then by spin sum
+    [[nodiscard]] std::uint64_t cell(long long bondSum, long long spinSum) const {
+        return static_cast<std::uint64_t>((bondSum + 2 * numOfSpins) / 2) * static_cast<std::uint64_t>(numOfSpins + 1)
+               + static_cast<std::uint64_t>((spinSum + numOfSpins) / 2);
+    }
+
+    [[nodiscard]] HistogramEntry entry(std::uint64_t i, std::uint64_t count) const {
+        const auto row = static_cast<long long>(i / static_cast<std::uint64_t>(numOfSpins + 1));
+        const auto column = static_cast<long long>(i % static_cast<std::uint64_t>(numOfSpins + 1));
+        return {2 * row - 2 * numOfSpins, 2 * column - numOfSpins, count};
+    }
+
+    void addCell(std::uint64_t i, std::uint64_t count) {
+        if (dense) {
+            cellCounts[i] += count;
+        } else {
+            sparseCounts[i] += count;
+        }
+        total += count;
+    }
+
+    unsigned int sights;
+    long long numOfSpins;
+    bool dense;
+    std::uint64_t total;
+    std::vector<std::uint64_t> cellCounts;
+    std::unordered_map<std::uint64_t, std::uint64_t> sparseCounts;
+};
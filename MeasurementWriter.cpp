@@ -0,0 +1,258 @@
+//
+// Created by chris on 17.10.26.
+//
+#include "MeasurementWriter.h"
+#include "SpinLattice2level.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <unistd.h>
+
+MeasurementWriter::Channel::Channel(MeasurementWriter &writer, unsigned int block, unsigned int chain,
+                                    std::uint64_t first)
+        : writer(writer), block(block), chain(chain), frontFirst(first), backFirst(first), writing(false) {
+    front.reserve(writer.bufferSize);
+    back.reserve(writer.bufferSize);
+}
+
+MeasurementWriter::Channel::~Channel() {
+    if (!front.empty()) {
+        submit();
+    }
+    std::unique_lock<std::mutex> lock(writer.mutex);
+    writer.written.wait(lock, [this]() { return !writing; });
+}
+
+void MeasurementWriter::Channel::submit() {
+    std::unique_lock<std::mutex> lock(writer.mutex);
+    writer.written.wait(lock, [this]() { return !writing; });
+    // back is empty now, the chain continues with it
+    std::swap(front, back);
+    backFirst = frontFirst;
+    frontFirst += back.size();
+    writing = true;
+    writer.pending.push_back(this);
+    writer.submitted.notify_one();
+}
+
+MeasurementWriter::MeasurementWriter(const std::string &path, ResultFormat format, const std::string &header,
+                                     size_t bufferSize, std::chrono::milliseconds syncInterval)
+        : format(format), bufferSize(std::max<size_t>(bufferSize, 1)), syncInterval(syncInterval),
+          file(open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)), lastSync(std::chrono::steady_clock::now()),
+          textEnd(0), recordEnd(sizeof(ResultFileHeader)), indexChanged(true), writtenRows(0), stop(false) {
+    if (file < 0) {
+        std::cerr << "Can't open " << path << " to write the measurements.\n";
+        exit(17);
+    }
+    if (format == ResultFormat::Tsv) {
+        writeAt(header.data(), header.size(), 0);
+        textEnd = header.size();
+    } else {
+        sync();
+    }
+    writer = std::thread([this]() { work(); });
+}
+
+MeasurementWriter::~MeasurementWriter() {
+    close();
+}
+
+unsigned int MeasurementWriter::addBlock(ResultBlock block) {
+    std::lock_guard<std::mutex> lock(mutex);
+    block.written = 0;
+    blocks.push_back(block);
+    indexChanged = true;
+    return static_cast<unsigned int>(blocks.size() - 1);
+}
+
+void MeasurementWriter::close() {
+    if (file < 0) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    submitted.notify_all();
+    writer.join();
+    sync();
+    ::close(file);
+    file = -1;
+}
+
+unsigned long long MeasurementWriter::getWrittenRows() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return writtenRows;
+}
+
+void MeasurementWriter::work() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        submitted.wait_for(lock, syncInterval, [this]() { return stop || !pending.empty(); });
+        if (pending.empty()) {
+            if (stop) {
+                return;
+            }
+            lock.unlock();
+            sync();
+            lock.lock();
+            continue;
+        }
+        Channel *channel = pending.front();
+        pending.pop_front();
+        // blocks can grow while the buffer is written
+        const ResultBlock block = blocks[channel->block];
+        lock.unlock();
+        if (format == ResultFormat::Tsv) {
+            writeTsv(block, channel->chain, channel->back);
+        } else {
+            writeBinary(channel->block, channel->backFirst, channel->back);
+        }
+        if (std::chrono::steady_clock::now() - lastSync >= syncInterval) {
+            sync();
+        }
+        lock.lock();
+        blocks[channel->block].written += channel->back.size();
+        indexChanged = true;
+        writtenRows += channel->back.size();
+        channel->back.clear();
+        channel->writing = false;
+        written.notify_all();
+    }
+}
+
+void MeasurementWriter::writeAt(const void *bytes, size_t size, std::uint64_t offset) {
+    const auto *pos = static_cast<const char *>(bytes);
+    while (size > 0) {
+        const ssize_t done = pwrite(file, pos, size, static_cast<off_t>(offset));
+        if (done <= 0) {
+            std::cerr << "Writing the measurements failed.\n";
+            exit(18);
+        }
+        pos += done;
+        size -= static_cast<size_t>(done);
+        offset += static_cast<std::uint64_t>(done);
+    }
+}
+
+void MeasurementWriter::writeTsv(const ResultBlock &block, unsigned int chain, const std::vector<Channel::Row> &rows) {
+    // same precision as the TSV of ising-headless
+    auto append = [this](char *pos, float value) {
+        return std::to_chars(pos, text.data() + text.size(), value, std::chars_format::fixed, 10).ptr;
+    };
+    auto appendInteger = [this](char *pos, long long value) {
+        return std::to_chars(pos, text.data() + text.size(), value).ptr;
+    };
+    // N, temp and chain are the same in every row of the buffer
+    char prefix[64];
+    char *end = std::to_chars(prefix, prefix + sizeof(prefix), block.sights).ptr;
+    *end++ = '\t';
+    end = std::to_chars(end, prefix + sizeof(prefix), block.temp, std::chars_format::fixed, 10).ptr;
+    *end++ = '\t';
+    const size_t prefixSize = end - prefix;
+    char suffix[16] = {'\t'};
+    const size_t suffixSize = std::to_chars(suffix + 1, suffix + sizeof(suffix) - 1, chain).ptr - suffix + 1;
+
+    suffix[suffixSize - 1] = '\t';
+
+    // a float with 10 decimals has at most 39 + 1 + 10 characters, a long long 20
+    text.resize(rows.size() * (prefixSize + 2 * 52 + suffixSize + 2 * 21));
+    char *pos = text.data();
+    for (const auto &row : rows) {
+        pos = std::copy(prefix, prefix + prefixSize, pos);
+        pos = append(pos, SpinLattice2level::normalizedMagnetization(row.spinSum, block.sights));
+        *pos++ = '\t';
+        pos = append(pos, SpinLattice2level::normalizedEnergy(row.bondSum, block.J, block.sights));
+        pos = std::copy(suffix, suffix + suffixSize, pos);
+        pos = appendInteger(pos, row.bondSum);
+        *pos++ = '\t';
+        pos = appendInteger(pos, row.spinSum);
+        *pos++ = '\n';
+    }
+    writeAt(text.data(), pos - text.data(), textEnd);
+    textEnd += pos - text.data();
+}
+
+void MeasurementWriter::writeBinary(unsigned int block, std::uint64_t first, const std::vector<Channel::Row> &rows) {
+    ResultChunk entry{};
+    entry.block = block;
+    entry.count = static_cast<std::uint32_t>(rows.size());
+    entry.first = first;
+    // the record starts with the entry and the block, they are copied to the front when the place is known
+    constexpr size_t chunkHeader = sizeof(ResultChunk) + sizeof(ResultBlock);
+    chunk.assign(chunkHeader, 0);
+    column.resize(rows.size());
+    std::transform(rows.begin(), rows.end(), column.begin(), [](const Channel::Row &row) { return row.bondSum; });
+    entry.bondBytes = static_cast<std::uint32_t>(encodeDeltas(column.data(), column.size(), chunk));
+    std::transform(rows.begin(), rows.end(), column.begin(), [](const Channel::Row &row) { return row.spinSum; });
+    entry.spinBytes = static_cast<std::uint32_t>(encodeDeltas(column.data(), column.size(), chunk));
+    std::uint64_t recordOffset;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::memcpy(chunk.data() + sizeof(ResultChunk), &blocks[block], sizeof(ResultBlock));
+        // behind the last index, so it stays valid until the header points to the next one
+        recordOffset = reserveRecord(chunk.size());
+    }
+    entry.offset = recordOffset + sizeof(ResultRecord) + chunkHeader;
+    std::memcpy(chunk.data(), &entry, sizeof(entry));
+    writeRecord(resultChunkRecord, chunk.data(), chunk.size(), recordOffset);
+    std::lock_guard<std::mutex> lock(mutex);
+    chunks.push_back(entry);
+    indexChanged = true;
+}
+
+std::uint64_t MeasurementWriter::reserveRecord(std::uint64_t size) {
+    const std::uint64_t offset = recordEnd;
+    recordEnd += sizeof(ResultRecord) + recordPadded(size);
+    return offset;
+}
+
+void MeasurementWriter::writeRecord(std::uint32_t type, const void *bytes, size_t size, std::uint64_t offset) {
+    // the header last: a record is only found if it was written completely
+    writeAt(bytes, size, offset + sizeof(ResultRecord));
+    ResultRecord record{};
+    record.type = type;
+    record.size = size;
+    writeAt(&record, sizeof(record), offset);
+}
+
+void MeasurementWriter::sync() {
+    std::vector<unsigned char> index;
+    std::uint64_t recordOffset = 0;
+    std::uint32_t numOfBlocks = 0;
+    std::uint64_t numOfChunks = 0;
+    bool changed;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        changed = format == ResultFormat::Binary && indexChanged;
+        if (changed) {
+            numOfBlocks = static_cast<std::uint32_t>(blocks.size());
+            numOfChunks = chunks.size();
+            index.resize(blocks.size() * sizeof(ResultBlock) + chunks.size() * sizeof(ResultChunk));
+            std::memcpy(index.data(), blocks.data(), blocks.size() * sizeof(ResultBlock));
+            std::memcpy(index.data() + blocks.size() * sizeof(ResultBlock), chunks.data(),
+                        chunks.size() * sizeof(ResultChunk));
+            // behind the chunks and the last index like a chunk, so the header can point to the last index until the
+            // new one is on the disk
+            recordOffset = reserveRecord(index.size());
+            indexChanged = false;
+        }
+    }
+    if (changed) {
+        writeRecord(resultIndexRecord, index.data(), index.size(), recordOffset);
+        // the index has to be on the disk before the header points to it
+        fdatasync(file);
+        ResultFileHeader header{};
+        std::memcpy(header.magic, resultFileMagic, sizeof(header.magic));
+        header.version = resultFileVersion;
+        header.numOfBlocks = numOfBlocks;
+        header.numOfChunks = numOfChunks;
+        header.indexOffset = recordOffset + sizeof(ResultRecord);
+        writeAt(&header, sizeof(header), 0);
+    }
+    fsync(file);
+    lastSync = std::chrono::steady_clock::now();
+}
@@ -0,0 +1,176 @@
+//
+// Created by chris on 17.10.26.
+//
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ResultFile.h"
+
+/**
+ * File format of a MeasurementWriter
+ */
+enum class ResultFormat {
+    // text with the columns N, temp, magnetization, energy, chain, bondSum, spinSum
+    Tsv,
+    // compressed bond and spin sums with an index of the (N, T) blocks, see ResultFile
+    Binary
+};
+
+/**
+ * Streams the measurements of running simulations to a file on a background thread, so they don't have to be kept in
+ * memory until the end of a run.
+ *
+ * The measurements of one (N, T) of a Simulation are a block, registered with addBlock before they are written. Every
+ * chain writes through its own Channel with two buffers: one is filled by the chain while the other one is formatted
+ * and written by the writer thread. A chain only waits if it filled a buffer before the last one was written, so the
+ * memory is bounded by two buffers per open channel. Every buffer is written to the OS right away and the file is
+ * synced to the disk every syncInterval. A crash of the program loses at most the buffers being filled or waiting for
+ * the writer thread, ResultFile also reads the chunks written after the last index. A crash of the system can lose
+ * what was written after the last sync.
+ *
+ * Binary files index every buffer with its place in the block. In a TSV file the rows of one chain are in order, but
+ * the chains are interleaved in blocks of one buffer: sort the rows stable by (N, temp, chain) to get the chains one
+ * after the other.
+ */
+class MeasurementWriter {
+public:
+    /**
+     * Measurements of one chain, only used by one thread at a time. The destructor writes the rest of the measurements
+     * and returns when they are written.
+     */
+    class Channel {
+    public:
+        /**
+         * @param block index from addBlock
+         * @param first index of the first measurement of the chain in its block
+         */
+        Channel(MeasurementWriter &writer, unsigned int block, unsigned int chain, std::uint64_t first);
+
+        Channel(const Channel &) = delete;
+
+        Channel &operator=(const Channel &) = delete;
+
+        ~Channel();
+
+        /**
+         * @param bondSum SpinLattice2level::getBondSum of the measurement
+         * @param spinSum SpinLattice2level::getSpinSum of the measurement
+         */
+        void push(long long bondSum, long long spinSum) {
+            front.push_back({bondSum, spinSum});
+            if (front.size() == writer.bufferSize) {
+                submit();
+            }
+        }
+
+    private:
+        friend class MeasurementWriter;
+
+        struct Row {
+            long long bondSum;
+            long long spinSum;
+        };
+
+        // hands the front buffer to the writer and continues with the back buffer once the writer is done with it
+        void submit();
+
+        MeasurementWriter &writer;
+        const unsigned int block;
+        const unsigned int chain;
+        // index in the block of the first measurement of front and back
+        std::uint64_t frontFirst;
+        std::uint64_t backFirst;
+        std::vector<Row> front;
+        std::vector<Row> back;
+        // back is written by the writer thread, guarded by writer.mutex
+        bool writing;
+    };
+
+    /**
+     * creates the file, exits if it can't be created
+     * @param header written to the top of a TSV file, e.g. the parameters and the column names
+     * @param bufferSize measurements per buffer of a Channel
+     * @param syncInterval time between two syncs of the file to the disk
+     */
+    MeasurementWriter(const std::string &path, ResultFormat format, const std::string &header = "",
+                      size_t bufferSize = 1 << 14, std::chrono::milliseconds syncInterval = std::chrono::seconds(10));
+
+    MeasurementWriter(const MeasurementWriter &) = delete;
+
+    MeasurementWriter &operator=(const MeasurementWriter &) = delete;
+
+    ~MeasurementWriter();
+
+    /**
+     * registers the block of the measurements of one (N, T)
+     * @param block parameters of the run and the number of measurements, written is set by the writer
+     * @return index of the block for the channels
+     */
+    unsigned int addBlock(ResultBlock block);
+
+    /**
+     * writes all submitted buffers, syncs and closes the file. All channels have to be destroyed before.
+     */
+    void close();
+
+    /**
+     * @return number of measurements written to the file so far
+     */
+    [[nodiscard]] unsigned long long getWrittenRows();
+
+private:
+    void work();
+
+    // writes size bytes at offset, exits if it fails
+    void writeAt(const void *bytes, size_t size, std::uint64_t offset);
+
+    // writes a buffer of a channel, the caller doesn't hold the mutex
+    void writeTsv(const ResultBlock &block, unsigned int chain, const std::vector<Channel::Row> &rows);
+
+    void writeBinary(unsigned int block, std::uint64_t first, const std::vector<Channel::Row> &rows);
+
+    // reserves the place of a record of a binary file behind the last one, the caller holds the mutex
+    std::uint64_t reserveRecord(std::uint64_t size);
+
+    // writes a record of a binary file at the reserved offset
+    void writeRecord(std::uint32_t type, const void *bytes, size_t size, std::uint64_t offset);
+
+    // writes the index of a binary file and syncs the file to the disk
+    void sync();
+
+    const ResultFormat format;
+    const size_t bufferSize;
+    const std::chrono::milliseconds syncInterval;
+    int file;
+    // only used by the writer thread
+    std::string text;
+    std::vector<long long> column;
+    std::vector<unsigned char> chunk;
+    std::chrono::steady_clock::time_point lastSync;
+    // end of the text of a TSV file
+    std::uint64_t textEnd;
+
+    std::mutex mutex;
+    // new buffers for the writer thread
+    std::condition_variable submitted;
+    // the writer thread is done with a buffer
+    std::condition_variable written;
+    std::deque<Channel *> pending;
+    std::vector<ResultBlock> blocks;
+    std::vector<ResultChunk> chunks;
+    // end of the last reserved chunk or index of a binary file
+    std::uint64_t recordEnd;
+    // blocks or chunks changed since the last index was written
+    bool indexChanged;
+    unsigned long long writtenRows;
+    bool stop;
+    std::thread writer;
+};
@@ -0,0 +1,276 @@
+//
+// Created by chris on 17.10.26.
+//
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Streaming mean and variance of a series (Welford): the squared deviations from the running mean are summed instead
+ * of the squares, so the variance doesn't cancel out even for millions of values close to each other. Two
+ * accumulators of parts of a series can be merged (Chan et al.).
+ */
+class RunningMoments {
+public:
+    void add(double value) {
+        count++;
+        const double delta = value - mean;
+        mean += delta / static_cast<double>(count);
+        squaredDeviations += delta * (value - mean);
+    }
+
+    /**
+     * adds all values of another accumulator, as if they followed the values of this one
+     */
+    void merge(const RunningMoments &other) {
+        if (other.count == 0) {
+            return;
+        }
+        const auto total = static_cast<double>(count + other.count);
+        const double delta = other.mean - mean;
+        mean += delta * static_cast<double>(other.count) / total;
+        squaredDeviations += other.squaredDeviations +
+                             delta * delta * static_cast<double>(count) * static_cast<double>(other.count) / total;
+        count += other.count;
+    }
+
+    [[nodiscard]] std::uint64_t getCount() const {
+        return count;
+    }
+
+    [[nodiscard]] double getMean() const {
+        return mean;
+    }
+
+    /**
+     * @return sample variance (divided by count - 1, like var in MATLAB), 0 for less than two values
+     */
+    [[nodiscard]] double getVariance() const {
+        return count < 2 ? 0 : squaredDeviations / static_cast<double>(count - 1);
+    }
+
+    /**
+     * @return mean of the squared values
+     */
+    [[nodiscard]] double getMeanOfSquares() const {
+        return count == 0 ? 0 : squaredDeviations / static_cast<double>(count) + mean * mean;
+    }
+
+private:
+    std::uint64_t count = 0;
+    double mean = 0;
+    double squaredDeviations = 0;
+};
+
+/**
+ * error estimate of the mean of a correlated series by BinningAnalysis
+ */
+struct BinningResult {
+    // integrated autocorrelation time, 0.5 for uncorrelated measurements
+    double tau;
+    // number of independent measurements, count / (2 tau)
+    double effectiveSamples;
+    // standard error of the mean, the naive error inflated by sqrt(2 tau)
+    double error;
+    // bins of 2^level measurements gave the estimate
+    unsigned int level;
+    // the estimates of two successive levels agreed, otherwise the series is too short for tau
+    bool converged;
+};
+
+/**
+ * Logarithmic binning (blocking) of a series while it is measured: level k has the moments of the means of
+ * consecutive bins of 2^k values. Every value is passed up to the next level as soon as its partner arrived, so only
+ * one open value and one RunningMoments per level are kept, O(log n) memory.
+ *
+ * The variance of the mean is var_k / n_k with the bins of level k. It grows with k until the bins are much longer
+ * than the autocorrelation time, then it stays on a plateau. tau = (var_k / n_k) / (var_0 / n_0) / 2 on the plateau.
+ */
+class BinningAnalysis {
+public:
+    // a level needs as many bins to be part of the estimate
+    static constexpr std::uint64_t minBins = 32;
+
+    void add(double value) {
+        for (size_t level = 0;; ++level) {
+            if (level == levels.size()) {
+                levels.emplace_back();
+                open.push_back(0);
+                hasOpen.push_back(false);
+            }
+            levels[level].add(value);
+            if (!hasOpen[level]) {
+                open[level] = value;
+                hasOpen[level] = true;
+                return;
+            }
+            // the bin of the next level is complete
+            value = (open[level] + value) / 2;
+            hasOpen[level] = false;
+        }
+    }
+
+    /**
+     * adds the bins of another series, e.g. another chain of the same temperature. Its open values are dropped, they
+     * would form bins across the two series.
+     */
+    void merge(const BinningAnalysis &other) {
+        if (levels.size() < other.levels.size()) {
+            levels.resize(other.levels.size());
+            open.resize(other.levels.size(), 0);
+            hasOpen.resize(other.levels.size(), false);
+        }
+        for (size_t level = 0; level < other.levels.size(); ++level) {
+            levels[level].merge(other.levels[level]);
+        }
+    }
+
+    /**
+     * @return moments of all values
+     */
+    [[nodiscard]] RunningMoments getMoments() const {
+        return levels.empty() ? RunningMoments() : levels[0];
+    }
+
+    [[nodiscard]] const std::vector<RunningMoments> &getLevels() const {
+        return levels;
+    }
+
+    /**
+     * Chooses the first level with at least minBins bins whose tau is within the statistical error of the tau of the
+     * next level (the relative error of a variance of n bins is sqrt(2 / (n - 1))). If there is none, the highest
+     * level with minBins bins is used and the result is not converged.
+     */
+    [[nodiscard]] BinningResult getResult() const {
+        BinningResult result{0.5, 0, 0, 0, false};
+        if (levels.empty() || levels[0].getCount() < 2 || levels[0].getVariance() == 0) {
+            result.effectiveSamples = levels.empty() ? 0 : static_cast<double>(levels[0].getCount());
+            result.converged = result.effectiveSamples > 0;
+            return result;
+        }
+        const double naive = levels[0].getVariance() / static_cast<double>(levels[0].getCount());
+        auto tauOf = [this, naive](size_t level) {
+            return levels[level].getVariance() / static_cast<double>(levels[level].getCount()) / naive / 2;
+        };
+        size_t chosen = 0;
+        for (size_t level = 0; level < levels.size() && levels[level].getCount() >= minBins; ++level) {
+            chosen = level;
+            if (level + 1 < levels.size() && levels[level + 1].getCount() >= minBins) {
+                const double tau = tauOf(level);
+                const double tolerance = tau * std::sqrt(2.0 / static_cast<double>(levels[level].getCount() - 1));
+                if (tauOf(level + 1) - tau < tolerance) {
+                    result.converged = true;
+                    break;
+                }
+            }
+        }
+        result.level = static_cast<unsigned int>(chosen);
+        // never below the uncorrelated value
+        result.tau = std::max(tauOf(chosen), 0.5);
+        result.effectiveSamples = static_cast<double>(levels[0].getCount()) / (2 * result.tau);
+        result.error = std::sqrt(naive * 2 * result.tau);
+        return result;
+    }
+
+private:
+    std::vector<RunningMoments> levels;
+    // value of every level which waits for its partner
+    std::vector<double> open;
+    std::vector<bool> hasOpen;
+};
+
+/**
+ * thermodynamic summary of the measurements of one temperature, with the normalized energy E and magnetization M of
+ * SpinLattice2level
+ */
+struct ThermoSummary {
+    float temp;
+    std::uint64_t count;
+    double meanEnergy;
+    double meanEnergySquared;
+    double meanAbsMagnetization;
+    double meanMagnetizationSquared;
+    double meanMagnetizationFourth;
+    // N² var(E) / T² of the normalized energy E = 0.5 - J bondSum / (4N²) in [0, 1], like heatCap in
+    // results/postCalculationsMulti.mlx. The energy per spin is 4E - 2, so the heat capacity per spin is 16 times this.
+    double heatCapacity;
+    // N² var(|M|) / T, M is the magnetization per spin like suscept in results/postCalculationsMulti.mlx
+    double susceptibility;
+    // 1 - <M⁴> / (3 <M²>²)
+    double binderCumulant;
+    // errors of <E> and <|M|> with their autocorrelation
+    BinningResult energyBinning;
+    BinningResult absMagnetizationBinning;
+};
+
+/**
+ * moments of the measurements of one temperature, E and |M| for the fluctuations, M² for <M²> and <M⁴>. E and |M|
+ * are binned for their autocorrelation.
+ */
+class ObservableMoments {
+public:
+    /**
+     * adds a measurement, in double precision from the exact sums
+     * @param bondSum SpinLattice2level::getBondSum
+     * @param spinSum SpinLattice2level::getSpinSum
+     */
+    void add(long long bondSum, long long spinSum, int J, unsigned int sights) {
+        const double numOfSpins = static_cast<double>(sights) * sights;
+        // like SpinLattice2level::normalizedEnergy and normalizedMagnetization
+        const double m = static_cast<double>(spinSum) / numOfSpins;
+        energyBins.add(0.5 - static_cast<double>(J) * static_cast<double>(bondSum) / (4 * numOfSpins));
+        absMagnetizationBins.add(m < 0 ? -m : m);
+        squaredMagnetization.add(m * m);
+    }
+
+    void merge(const ObservableMoments &other) {
+        energyBins.merge(other.energyBins);
+        absMagnetizationBins.merge(other.absMagnetizationBins);
+        squaredMagnetization.merge(other.squaredMagnetization);
+    }
+
+    /**
+     * @return the summary in the convention of ThermoSummary, the heat capacity is the one of the normalized energy
+     */
+    [[nodiscard]] ThermoSummary summarize(float temp, unsigned int sights) const {
+        const double numOfSpins = static_cast<double>(sights) * sights;
+        const double m2 = squaredMagnetization.getMean();
+        const double m4 = squaredMagnetization.getMeanOfSquares();
+        const RunningMoments energy = energyBins.getMoments();
+        const RunningMoments absMagnetization = absMagnetizationBins.getMoments();
+        ThermoSummary summary{};
+        summary.temp = temp;
+        summary.count = energy.getCount();
+        summary.meanEnergy = energy.getMean();
+        summary.meanEnergySquared = energy.getMeanOfSquares();
+        summary.meanAbsMagnetization = absMagnetization.getMean();
+        summary.meanMagnetizationSquared = m2;
+        summary.meanMagnetizationFourth = m4;
+        summary.heatCapacity = numOfSpins * energy.getVariance() / (static_cast<double>(temp) * temp);
+        summary.susceptibility = numOfSpins * absMagnetization.getVariance() / temp;
+        summary.binderCumulant = m2 == 0 ? 0 : 1 - m4 / (3 * m2 * m2);
+        summary.energyBinning = energyBins.getResult();
+        summary.absMagnetizationBinning = absMagnetizationBins.getResult();
+        return summary;
+    }
+
+    [[nodiscard]] const BinningAnalysis &getEnergy() const {
+        return energyBins;
+    }
+
+    [[nodiscard]] const BinningAnalysis &getAbsMagnetization() const {
+        return absMagnetizationBins;
+    }
+
+    [[nodiscard]] const RunningMoments &getSquaredMagnetization() const {
+        return squaredMagnetization;
+    }
+
+private:
+    BinningAnalysis energyBins;
+    BinningAnalysis absMagnetizationBins;
+    RunningMoments squaredMagnetization;
+};
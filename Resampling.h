@@ -0,0 +1,295 @@
+//
+// Created by chris on 17.10.26.
+//
+#pragma once
+
+#include "Histogram.h"
+#include "Reweighting.h"
+#include "Rng.h"
+#include "Strips.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/**
+ * how often every bin of every data set is used by one replica, multiplicities[set][bin]. 1 for all bins is the
+ * whole data.
+ */
+using Multiplicities = std::vector<std::vector<std::uint32_t>>;
+
+/**
+ * errors of every value an estimator returns
+ */
+struct ResamplingResult {
+    // the estimator on the whole data
+    std::vector<double> estimate;
+    // mean of the replicas
+    std::vector<double> replicaMean;
+    std::vector<double> error;
+    // estimated bias of the estimate, subtract it for a bias corrected estimate
+    std::vector<double> bias;
+};
+
+/**
+ * Jackknife and bootstrap errors of an arbitrary estimator of several data sets, e.g. the temperatures of a grid.
+ * Every data set is split into bins which should be longer than the autocorrelation time (see BinningAnalysis), the
+ * replicas only change how often every bin is used. The estimator gets the Multiplicities of one replica and returns
+ * any number of values, e.g. heat capacity, susceptibility and Binder cumulant of every temperature or the position
+ * of a reweighted peak. It is called concurrently and must not change shared state. It runs on the pool and may use
+ * the pool itself, e.g. through autocorrelations: TaskGroup::wait runs queued tasks instead of blocking the worker.
+ *
+ * The replicas run in parallel on the pool. Every bootstrap replica draws from its own stream derived from
+ * (seed, replica), so the results don't depend on the number of threads.
+ */
+class Resampler {
+public:
+    explicit Resampler(std::vector<size_t> binsPerSet, ThreadPool &pool = sharedPool())
+            : binsPerSet(std::move(binsPerSet)), pool(pool) {}
+
+    /**
+     * delete-one jackknife: every replica leaves out one bin of one data set. The data sets are independent, so
+     * their variances add: var = sum_k (n_k - 1) / n_k sum_i (theta_(k,i) - mean_k)². Data sets with less than two
+     * bins aren't resampled.
+     */
+    template<typename Estimator>
+    ResamplingResult jackknife(Estimator &&estimator) const {
+        // replicas of every data set, the ones of set k follow the ones of set k-1
+        std::vector<size_t> firstReplica(binsPerSet.size() + 1, 0);
+        for (size_t k = 0; k < binsPerSet.size(); ++k) {
+            firstReplica[k + 1] = firstReplica[k] + (binsPerSet[k] < 2 ? 0 : binsPerSet[k]);
+        }
+        const auto replicas = runReplicas(firstReplica.back(), estimator, [&](size_t r, Multiplicities &weights) {
+            const auto set = static_cast<size_t>(std::upper_bound(firstReplica.begin(), firstReplica.end(), r) -
+                                                 firstReplica.begin() - 1);
+            weights[set][r - firstReplica[set]] = 0;
+        });
+
+        ResamplingResult result = summarize(estimator, replicas);
+        for (size_t v = 0; v < result.estimate.size(); ++v) {
+            double variance = 0, bias = 0;
+            for (size_t k = 0; k < binsPerSet.size(); ++k) {
+                const size_t n = firstReplica[k + 1] - firstReplica[k];
+                if (n == 0) {
+                    continue;
+                }
+                double mean = 0;
+                for (size_t r = firstReplica[k]; r < firstReplica[k + 1]; ++r) {
+                    mean += replicas[r][v];
+                }
+                mean /= static_cast<double>(n);
+                double squares = 0;
+                for (size_t r = firstReplica[k]; r < firstReplica[k + 1]; ++r) {
+                    squares += (replicas[r][v] - mean) * (replicas[r][v] - mean);
+                }
+                variance += static_cast<double>(n - 1) / static_cast<double>(n) * squares;
+                bias += static_cast<double>(n - 1) * (mean - result.estimate[v]);
+            }
+            result.error[v] = std::sqrt(variance);
+            result.bias[v] = bias;
+        }
+        return result;
+    }
+
+    /**
+     * bootstrap: every replica draws n_k bins with replacement from every data set k
+     * @return standard deviation of the replicas as error, their mean minus the estimate as bias
+     */
+    template<typename Estimator>
+    ResamplingResult bootstrap(Estimator &&estimator, unsigned int numOfReplicas, std::uint64_t seed) const {
+        const auto replicas = runReplicas(numOfReplicas, estimator, [&](size_t r, Multiplicities &weights) {
+            Xoshiro256ss rng(deriveSeed(seed, {bootstrapStreamKey, r}));
+            for (size_t k = 0; k < binsPerSet.size(); ++k) {
+                std::fill(weights[k].begin(), weights[k].end(), 0);
+                for (size_t i = 0; i < binsPerSet[k]; ++i) {
+                    weights[k][rng.bounded(static_cast<std::uint32_t>(binsPerSet[k]))]++;
+                }
+            }
+        });
+
+        ResamplingResult result = summarize(estimator, replicas);
+        for (size_t v = 0; v < result.estimate.size(); ++v) {
+            double squares = 0;
+            for (const auto &replica : replicas) {
+                squares += (replica[v] - result.replicaMean[v]) * (replica[v] - result.replicaMean[v]);
+            }
+            result.error[v] = replicas.size() < 2 ? 0 : std::sqrt(squares / static_cast<double>(replicas.size() - 1));
+            result.bias[v] = result.replicaMean[v] - result.estimate[v];
+        }
+        return result;
+    }
+
+    /**
+     * @return multiplicity 1 for every bin, the whole data
+     */
+    [[nodiscard]] Multiplicities wholeData() const {
+        Multiplicities weights;
+        for (const size_t bins : binsPerSet) {
+            weights.emplace_back(bins, 1);
+        }
+        return weights;
+    }
+
+private:
+    /**
+     * evaluates the estimator of count replicas in parallel, resample(r, weights) sets the multiplicities of replica r
+     * starting from wholeData
+     */
+    template<typename Estimator, typename Resample>
+    std::vector<std::vector<double>> runReplicas(size_t count, Estimator &estimator, Resample &&resample) const {
+        std::vector<std::vector<double>> replicas(count);
+        const auto total = static_cast<unsigned int>(count);
+        // a few chunks per worker, so a slow chunk doesn't keep the others waiting
+        const unsigned int chunks = std::min(total, 4 * pool.size());
+        TaskGroup group(pool);
+        for (unsigned int chunk = 0; chunk < chunks; ++chunk) {
+            group.submit([&, chunk]() {
+                for (size_t r = stripBegin(chunk, chunks, total); r < stripBegin(chunk + 1, chunks, total); ++r) {
+                    Multiplicities weights = wholeData();
+                    resample(r, weights);
+                    replicas[r] = estimator(static_cast<const Multiplicities &>(weights));
+                }
+            });
+        }
+        group.wait();
+        return replicas;
+    }
+
+    /**
+     * the estimate of the whole data and the mean of the replicas, error and bias sized
+     */
+    template<typename Estimator>
+    ResamplingResult summarize(Estimator &estimator, const std::vector<std::vector<double>> &replicas) const {
+        ResamplingResult result;
+        result.estimate = estimator(static_cast<const Multiplicities &>(wholeData()));
+        result.replicaMean.assign(result.estimate.size(), 0);
+        for (const auto &replica : replicas) {
+            for (size_t v = 0; v < result.estimate.size(); ++v) {
+                result.replicaMean[v] += replica[v] / static_cast<double>(replicas.size());
+            }
+        }
+        if (replicas.empty()) {
+            result.replicaMean = result.estimate;
+        }
+        result.error.assign(result.estimate.size(), 0);
+        result.bias.assign(result.estimate.size(), 0);
+        return result;
+    }
+
+    // key of the random streams of the bootstrap, the lattices use (seed, N, T)
+    static constexpr std::uint64_t bootstrapStreamKey = 0x424f4f54ull;
+
+    std::vector<size_t> binsPerSet;
+    ThreadPool &pool;
+};
+
+/**
+ * The measurements of one (N, T) in consecutive bins of nearly the same length: the sums of the moments of the
+ * normalized energy and magnetization per bin and optionally the JointHistogram of every bin. A data set of
+ * Resampler, observables and histogram give the data of one replica.
+ */
+class ObservableBins {
+public:
+    /**
+     * @param bondSums measurements of one temperature in the order of the simulation, e.g. of a ResultFile block
+     * @param withHistograms keep a histogram per bin for reweighting based estimators
+     */
+    ObservableBins(unsigned int sights, float temp, int J, const std::vector<long long> &bondSums,
+                   const std::vector<long long> &spinSums, unsigned int numOfBins, bool withHistograms)
+            : sights(sights), temp(temp) {
+        const auto count = static_cast<unsigned int>(std::min(bondSums.size(), spinSums.size()));
+        numOfBins = std::clamp(numOfBins, 1u, std::max(count, 1u));
+        const double numOfSpins = static_cast<double>(sights) * sights;
+        bins.assign(count == 0 ? 0 : numOfBins, BinSums{});
+        if (withHistograms) {
+            histograms.assign(bins.size(), JointHistogram(sights, HistogramStorage::Sparse));
+        }
+        for (unsigned int b = 0; b < bins.size(); ++b) {
+            BinSums &bin = bins[b];
+            for (unsigned int i = stripBegin(b, numOfBins, count); i < stripBegin(b + 1, numOfBins, count); ++i) {
+                // like SpinLattice2level::normalizedEnergy and normalizedMagnetization
+                const double energy = 0.5 - static_cast<double>(J) * static_cast<double>(bondSums[i]) /
+                                            (4 * numOfSpins);
+                const double m = static_cast<double>(spinSums[i]) / numOfSpins;
+                bin.count += 1;
+                bin.energy += energy;
+                bin.energySquared += energy * energy;
+                bin.absMagnetization += std::abs(m);
+                bin.magnetizationSquared += m * m;
+                bin.magnetizationFourth += m * m * m * m;
+                if (withHistograms) {
+                    histograms[b].add(bondSums[i], spinSums[i]);
+                }
+            }
+        }
+    }
+
+    [[nodiscard]] size_t getNumOfBins() const {
+        return bins.size();
+    }
+
+    [[nodiscard]] float getTemp() const {
+        return temp;
+    }
+
+    /**
+     * @return the observables of the bins, every bin counted as often as its multiplicity. The variances are the
+     * ones of the population like with MultiHistogram::evaluate.
+     */
+    [[nodiscard]] ReweightedPoint observables(const std::vector<std::uint32_t> &multiplicities) const {
+        double count = 0, energy = 0, energySquared = 0, absM = 0, m2 = 0, m4 = 0;
+        for (size_t b = 0; b < bins.size(); ++b) {
+            const double weight = multiplicities[b];
+            count += weight * bins[b].count;
+            energy += weight * bins[b].energy;
+            energySquared += weight * bins[b].energySquared;
+            absM += weight * bins[b].absMagnetization;
+            m2 += weight * bins[b].magnetizationSquared;
+            m4 += weight * bins[b].magnetizationFourth;
+        }
+        ReweightedPoint point{};
+        point.temp = temp;
+        if (count == 0) {
+            return point;
+        }
+        energy /= count, energySquared /= count, absM /= count, m2 /= count, m4 /= count;
+        const double numOfSpins = static_cast<double>(sights) * sights;
+        point.meanEnergy = energy;
+        point.meanAbsMagnetization = absM;
+        point.meanMagnetizationSquared = m2;
+        point.meanMagnetizationFourth = m4;
+        point.heatCapacity = numOfSpins * (energySquared - energy * energy) / (static_cast<double>(temp) * temp);
+        point.susceptibility = numOfSpins * (m2 - absM * absM) / temp;
+        point.binderCumulant = m2 == 0 ? 0 : 1 - m4 / (3 * m2 * m2);
+        return point;
+    }
+
+    /**
+     * @return histogram of the bins, every bin counted as often as its multiplicity, e.g. for MultiHistogram::addRun.
+     * Empty without withHistograms.
+     */
+    [[nodiscard]] JointHistogram histogram(const std::vector<std::uint32_t> &multiplicities) const {
+        JointHistogram result(sights, HistogramStorage::Sparse);
+        for (size_t b = 0; b < histograms.size(); ++b) {
+            result.merge(histograms[b], multiplicities[b]);
+        }
+        return result;
+    }
+
+private:
+    struct BinSums {
+        double count;
+        double energy;
+        double energySquared;
+        double absMagnetization;
+        double magnetizationSquared;
+        double magnetizationFourth;
+    };
+
+    unsigned int sights;
+    float temp;
+    std::vector<BinSums> bins;
+    std::vector<JointHistogram> histograms;
+};
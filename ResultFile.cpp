@@ -0,0 +1,207 @@
+//
+// Created by chris on 17.10.26.
+//
+#include "ResultFile.h"
+#include "SpinLattice2level.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+size_t encodeDeltas(const long long *values, size_t count, std::vector<unsigned char> &bytes) {
+    const size_t begin = bytes.size();
+    long long last = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const auto delta = static_cast<std::uint64_t>(values[i]) - static_cast<std::uint64_t>(last);
+        last = values[i];
+        // zigzag: small negative and positive differences get small codes
+        std::uint64_t code = (delta << 1) ^ (0 - (delta >> 63));
+        while (code >= 0x80) {
+            bytes.push_back(static_cast<unsigned char>(code | 0x80));
+            code >>= 7;
+        }
+        bytes.push_back(static_cast<unsigned char>(code));
+    }
+    return bytes.size() - begin;
+}
+
+size_t decodeDeltas(const unsigned char *bytes, size_t size, size_t count, long long *values) {
+    size_t pos = 0;
+    std::uint64_t last = 0;
+    for (size_t i = 0; i < count; ++i) {
+        std::uint64_t code = 0;
+        for (unsigned int shift = 0;; shift += 7) {
+            if (pos == size || shift > 63) {
+                return 0;
+            }
+            const unsigned char byte = bytes[pos++];
+            code |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+            if (byte < 0x80) {
+                break;
+            }
+        }
+        last += (code >> 1) ^ (0 - (code & 1));
+        values[i] = static_cast<long long>(last);
+    }
+    return pos;
+}
+
+ResultFile::ResultFile(const std::string &path) : path(path), data(nullptr), size(0) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    struct stat info{};
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        std::cerr << "Can't open the result file " << path << ".\n";
+        exit(19);
+    }
+    size = static_cast<size_t>(info.st_size);
+    if (size >= sizeof(ResultFileHeader)) {
+        void *mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        data = mapped == MAP_FAILED ? nullptr : static_cast<const unsigned char *>(mapped);
+    }
+    close(fd);
+
+    ResultFileHeader header{};
+    if (data == nullptr) {
+        invalid();
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, resultFileMagic, sizeof(resultFileMagic)) != 0 ||
+        header.version != resultFileVersion || header.indexOffset % alignof(ResultBlock) != 0 ||
+        header.indexOffset < sizeof(ResultFileHeader) + sizeof(ResultRecord) || header.indexOffset > size ||
+        (size - header.indexOffset) / sizeof(ResultBlock) < header.numOfBlocks ||
+        (size - header.indexOffset - header.numOfBlocks * sizeof(ResultBlock)) / sizeof(ResultChunk) <
+        header.numOfChunks) {
+        invalid();
+    }
+    blocks.resize(header.numOfBlocks);
+    std::memcpy(blocks.data(), data + header.indexOffset, blocks.size() * sizeof(ResultBlock));
+    chunksOfBlock.resize(blocks.size());
+    const unsigned char *indexChunks = data + header.indexOffset + blocks.size() * sizeof(ResultBlock);
+    for (size_t i = 0; i < header.numOfChunks; ++i) {
+        ResultChunk chunk{};
+        std::memcpy(&chunk, indexChunks + i * sizeof(ResultChunk), sizeof(chunk));
+        if (chunk.offset > header.indexOffset) {
+            invalid();
+        }
+        addChunk(chunk);
+    }
+
+    // the records behind the index up to the first one which wasn't written completely, e.g. of an aborted run
+    const size_t indexedBlocks = blocks.size();
+    // index in blocks of every block of the writer behind the indexed ones
+    std::vector<size_t> recoveredBlocks;
+    std::uint64_t pos = header.indexOffset + recordPadded(header.numOfBlocks * sizeof(ResultBlock) +
+                                                          header.numOfChunks * sizeof(ResultChunk));
+    constexpr size_t chunkHeader = sizeof(ResultChunk) + sizeof(ResultBlock);
+    while (pos <= size && size - pos >= sizeof(ResultRecord)) {
+        ResultRecord record{};
+        std::memcpy(&record, data + pos, sizeof(record));
+        if ((record.type != resultChunkRecord && record.type != resultIndexRecord) ||
+            size - pos - sizeof(ResultRecord) < record.size) {
+            break;
+        }
+        if (record.type == resultChunkRecord) {
+            ResultChunk chunk{};
+            ResultBlock block{};
+            if (record.size < chunkHeader) {
+                invalid();
+            }
+            std::memcpy(&chunk, data + pos + sizeof(ResultRecord), sizeof(chunk));
+            std::memcpy(&block, data + pos + sizeof(ResultRecord) + sizeof(chunk), sizeof(block));
+            if (chunk.offset != pos + sizeof(ResultRecord) + chunkHeader ||
+                record.size != chunkHeader + static_cast<std::uint64_t>(chunk.bondBytes) + chunk.spinBytes) {
+                invalid();
+            }
+            if (chunk.block >= indexedBlocks) {
+                const size_t recovered = chunk.block - indexedBlocks;
+                if (recovered >= recoveredBlocks.size()) {
+                    recoveredBlocks.resize(recovered + 1, SIZE_MAX);
+                }
+                if (recoveredBlocks[recovered] == SIZE_MAX) {
+                    recoveredBlocks[recovered] = blocks.size();
+                    blocks.push_back(block);
+                    chunksOfBlock.emplace_back();
+                }
+                chunk.block = static_cast<std::uint32_t>(recoveredBlocks[recovered]);
+            }
+            addChunk(chunk);
+        }
+        pos += sizeof(ResultRecord) + recordPadded(record.size);
+    }
+    for (size_t block = 0; block < blocks.size(); ++block) {
+        blocks[block].written = 0;
+        for (const auto &chunk : chunksOfBlock[block]) {
+            blocks[block].written += chunk.count;
+        }
+    }
+}
+
+ResultFile::~ResultFile() {
+    if (data != nullptr) {
+        munmap(const_cast<unsigned char *>(data), size);
+    }
+}
+
+void ResultFile::addChunk(const ResultChunk &chunk) {
+    if (chunk.block >= blocks.size() || chunk.first > blocks[chunk.block].count ||
+        blocks[chunk.block].count - chunk.first < chunk.count || chunk.offset > size ||
+        size - chunk.offset < static_cast<std::uint64_t>(chunk.bondBytes) + chunk.spinBytes) {
+        invalid();
+    }
+    chunksOfBlock[chunk.block].push_back(chunk);
+}
+
+void ResultFile::invalid() const {
+    std::cerr << path << " is not a valid result file.\n";
+    exit(19);
+}
+
+size_t ResultFile::findBlock(unsigned int sights, float temp) const {
+    for (size_t block = 0; block < blocks.size(); ++block) {
+        if (blocks[block].sights == sights && blocks[block].temp == temp) {
+            return block;
+        }
+    }
+    return blocks.size();
+}
+
+std::vector<long long> ResultFile::decode(size_t block, bool spins) const {
+    std::vector<long long> values(blocks[block].count, 0);
+    for (const auto &chunk : chunksOfBlock[block]) {
+        const unsigned char *bytes = data + chunk.offset + (spins ? chunk.bondBytes : 0);
+        const size_t numOfBytes = spins ? chunk.spinBytes : chunk.bondBytes;
+        if (decodeDeltas(bytes, numOfBytes, chunk.count, values.data() + chunk.first) != numOfBytes) {
+            invalid();
+        }
+    }
+    return values;
+}
+
+std::vector<long long> ResultFile::getBondSums(size_t block) const {
+    return decode(block, false);
+}
+
+std::vector<long long> ResultFile::getSpinSums(size_t block) const {
+    return decode(block, true);
+}
+
+std::vector<float> ResultFile::getEnergies(size_t block) const {
+    const auto bondSums = getBondSums(block);
+    std::vector<float> energies(bondSums.size());
+    for (size_t i = 0; i < bondSums.size(); ++i) {
+        energies[i] = SpinLattice2level::normalizedEnergy(bondSums[i], blocks[block].J, blocks[block].sights);
+    }
+    return energies;
+}
+
+std::vector<float> ResultFile::getMagnetization(size_t block) const {
+    const auto spinSums = getSpinSums(block);
+    std::vector<float> magnetization(spinSums.size());
+    for (size_t i = 0; i < spinSums.size(); ++i) {
+        magnetization[i] = SpinLattice2level::normalizedMagnetization(spinSums[i], blocks[block].sights);
+    }
+    return magnetization;
+}
@@ -0,0 +1,180 @@
+//
+// Created by chris on 17.10.26.
+//
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Binary result file of MeasurementWriter with ResultFormat::Binary, all numbers little-endian:
+ *
+ *  - ResultFileHeader at offset 0
+ *  - the chunks: the exact bond sums and spin sums of consecutive measurements of one chain, as written by one buffer
+ *    of the writer. Each is stored as the differences to the measurement before (the first one to 0), zigzag- and
+ *    varint-encoded (see encodeDeltas): consecutive measurements differ little, so most need one or two bytes.
+ *    First all bond sums of the chunk, then all spin sums.
+ *  - the index at indexOffset: one ResultBlock per (N, T) of a Simulation, then one ResultChunk per chunk
+ *
+ * Every chunk and index is a ResultRecord, aligned to 8 bytes and written one after the other. A chunk record starts
+ * with its ResultChunk and the ResultBlock of its block, so it describes itself. The index is rewritten after the
+ * chunks with every sync of the writer, the records behind the last index are found by reading them one after the
+ * other: a file of an aborted run can be read up to the last written chunk. Measurements which were never written
+ * are 0.
+ */
+struct ResultFileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t numOfBlocks;
+    std::uint64_t numOfChunks;
+    std::uint64_t indexOffset;
+};
+
+/**
+ * header of a chunk or an index, the record is padded to a multiple of 8 bytes
+ */
+struct ResultRecord {
+    // resultChunkRecord or resultIndexRecord, 0 where nothing was written
+    std::uint32_t type;
+    std::uint32_t reserved;
+    // bytes after the header without the padding
+    std::uint64_t size;
+};
+
+/**
+ * value of algorithm, sweepsPerIteration and thermalizeSweeps of a ResultBlock if the run didn't record them, e.g. of
+ * a converted TSV file
+ */
+constexpr std::uint32_t resultUnknown = UINT32_MAX;
+
+/**
+ * index entry of one (N, T) block with the parameters of its run
+ */
+struct ResultBlock {
+    std::uint32_t sights;
+    float temp;
+    // Algorithm of the Simulation, resultUnknown if unknown
+    std::uint32_t algorithm;
+    // resultUnknown if unknown, like thermalizeSweeps
+    std::uint32_t sweepsPerIteration;
+    std::uint32_t thermalizeSweeps;
+    // chain c has the measurements stripBegin(c, chains, count) to stripBegin(c + 1, chains, count)
+    std::uint32_t chains;
+    // coupling and extern field of the lattices, to get the energy of a bond sum
+    std::int32_t J;
+    std::int32_t h;
+    std::uint64_t seed;
+    // number of measurements
+    std::uint64_t count;
+    // measurements written, ResultFile counts them from the chunks it finds
+    std::uint64_t written;
+};
+
+/**
+ * index entry of the measurements first to first + count - 1 of a block, the chunk starts at offset
+ */
+struct ResultChunk {
+    std::uint32_t block;
+    std::uint32_t count;
+    std::uint64_t first;
+    std::uint64_t offset;
+    std::uint32_t bondBytes;
+    std::uint32_t spinBytes;
+};
+
+static_assert(sizeof(ResultFileHeader) == 32 && sizeof(ResultRecord) == 16 && sizeof(ResultBlock) == 56 &&
+              sizeof(ResultChunk) == 32, "fixed layout of the result file");
+
+constexpr char resultFileMagic[8] = {'I', 'S', 'I', 'N', 'G', 'R', 'E', 'S'};
+constexpr std::uint32_t resultFileVersion = 3;
+// ResultRecord::type of a chunk, followed by its ResultChunk, the ResultBlock of its block and the encoded sums
+constexpr std::uint32_t resultChunkRecord = 0x4b4e4843;
+// ResultRecord::type of an index, the ResultBlock and ResultChunk entries follow
+constexpr std::uint32_t resultIndexRecord = 0x58444e49;
+
+/**
+ * @return size rounded up to the alignment of the records
+ */
+constexpr std::uint64_t recordPadded(std::uint64_t size) {
+    return (size + 7) / 8 * 8;
+}
+
+/**
+ * appends the differences of the successive values (the first one to 0) as zigzag varints: 7 bits per byte, the
+ * highest bit is set if more bytes follow
+ * @return number of appended bytes
+ */
+size_t encodeDeltas(const long long *values, size_t count, std::vector<unsigned char> &bytes);
+
+/**
+ * reverse of encodeDeltas
+ * @return number of read bytes, 0 if the bytes end before count values are decoded
+ */
+size_t decodeDeltas(const unsigned char *bytes, size_t size, size_t count, long long *values);
+
+/**
+ * Read-only view of a binary result file: the file is memory-mapped, only the chunks of the requested block are
+ * decoded, so only their pages are loaded. The chunks behind the last index are added to it, blocks which aren't in
+ * the index yet get the next indices. Exits if the file is not a valid result file.
+ */
+class ResultFile {
+public:
+    explicit ResultFile(const std::string &path);
+
+    ResultFile(const ResultFile &) = delete;
+
+    ResultFile &operator=(const ResultFile &) = delete;
+
+    ~ResultFile();
+
+    [[nodiscard]] size_t getNumOfBlocks() const {
+        return blocks.size();
+    }
+
+    [[nodiscard]] const ResultBlock &getBlock(size_t block) const {
+        return blocks[block];
+    }
+
+    /**
+     * @return index of the block of the given lattice size and temperature, getNumOfBlocks() if there is none
+     */
+    [[nodiscard]] size_t findBlock(unsigned int sights, float temp) const;
+
+    /**
+     * @return exact sums over all bonds of the measurements of a block
+     */
+    [[nodiscard]] std::vector<long long> getBondSums(size_t block) const;
+
+    /**
+     * @return exact sums over all spins of the measurements of a block
+     */
+    [[nodiscard]] std::vector<long long> getSpinSums(size_t block) const;
+
+    /**
+     * @return energies like SpinLattice2level::calcEnergy
+     */
+    [[nodiscard]] std::vector<float> getEnergies(size_t block) const;
+
+    /**
+     * @return magnetizations like SpinLattice2level::calcMagnetization
+     */
+    [[nodiscard]] std::vector<float> getMagnetization(size_t block) const;
+
+private:
+    // decodes the bond sums (spins = false) or the spin sums of all chunks of a block
+    [[nodiscard]] std::vector<long long> decode(size_t block, bool spins) const;
+
+    // checks the place of a chunk and adds it to its block
+    void addChunk(const ResultChunk &chunk);
+
+    [[noreturn]] void invalid() const;
+
+    std::string path;
+    const unsigned char *data;
+    size_t size;
+    std::vector<ResultBlock> blocks;
+    // chunks of every block
+    std::vector<std::vector<ResultChunk>> chunksOfBlock;
+};
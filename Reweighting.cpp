@@ -0,0 +1,209 @@
+//
+// Created by chris on 17.10.26.
+//
+#include "Reweighting.h"
+#include "Strips.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+MultiHistogram::MultiHistogram(unsigned int sights, int J, int h) : sights(sights), J(J), h(h) {}
+
+void MultiHistogram::addRun(float temp, const std::vector<long long> &bondSums,
+                            const std::vector<long long> &spinSums) {
+    if (bondSums.size() != spinSums.size()) {
+        std::cerr << "The run at T=" << temp << " has " << bondSums.size() << " bond sums but " << spinSums.size()
+                  << " spin sums.\n";
+        exit(22);
+    }
+    for (size_t i = 0; i < bondSums.size(); ++i) {
+        addToBin(bondSums[i], spinSums[i], 1);
+    }
+    runTemps.push_back(temp);
+    runCounts.push_back(static_cast<double>(bondSums.size()));
+    freeEnergies.push_back(0);
+}
+
+void MultiHistogram::addRun(float temp, const JointHistogram &histogram) {
+    if (histogram.getSights() != sights) {
+        std::cerr << "The histogram at T=" << temp << " is of N=" << histogram.getSights() << " instead of N="
+                  << sights << ".\n";
+        exit(22);
+    }
+    for (const auto &entry : histogram.getEntries()) {
+        addToBin(entry.bondSum, entry.spinSum, entry.count);
+    }
+    runTemps.push_back(temp);
+    runCounts.push_back(static_cast<double>(histogram.getCount()));
+    freeEnergies.push_back(0);
+}
+
+void MultiHistogram::addToBin(long long bondSum, long long spinSum, std::uint64_t count) {
+    // like SpinLattice2level::getTotalEnergy, normalizedEnergy and normalizedMagnetization
+    const double numOfSpins = static_cast<double>(sights) * sights;
+    const long long totalEnergy = -1LL * J * bondSum - 1LL * h * spinSum;
+    const double energy = 0.5 - static_cast<double>(J) * static_cast<double>(bondSum) / (4 * numOfSpins);
+    const double m = static_cast<double>(spinSum) / numOfSpins;
+    const auto n = static_cast<double>(count);
+    auto &bin = bins[totalEnergy];
+    bin.count += n;
+    bin.energy += n * energy;
+    bin.energySquared += n * energy * energy;
+    bin.absMagnetization += n * std::abs(m);
+    bin.magnetizationSquared += n * m * m;
+    bin.magnetizationFourth += n * m * m * m * m;
+}
+
+void MultiHistogram::logDenominators(size_t begin, size_t end, std::vector<double> &result) const {
+    const size_t numOfRuns = runTemps.size();
+    std::vector<double> offsets(numOfRuns), terms(numOfRuns);
+    for (size_t k = 0; k < numOfRuns; ++k) {
+        // ln 0 = -inf, a run without measurements adds exp(-inf) = 0 and doesn't count
+        offsets[k] = std::log(runCounts[k]) + freeEnergies[k];
+    }
+    for (size_t e = begin; e < end; ++e) {
+        double largest = -std::numeric_limits<double>::infinity();
+        for (size_t k = 0; k < numOfRuns; ++k) {
+            terms[k] = offsets[k] - energies[e] / runTemps[k];
+            largest = std::max(largest, terms[k]);
+        }
+        double sum = 0;
+        for (size_t k = 0; k < numOfRuns; ++k) {
+            sum += std::exp(terms[k] - largest);
+        }
+        result[e] = largest + std::log(sum);
+    }
+}
+
+bool MultiHistogram::solve(unsigned int threads, double tolerance, unsigned int maxIterations) {
+    energies.clear();
+    binList.clear();
+    for (const auto &[energy, bin] : bins) {
+        energies.push_back(static_cast<double>(energy));
+        binList.push_back(bin);
+    }
+    const size_t numOfRuns = runTemps.size();
+    const auto numOfEnergies = static_cast<unsigned int>(energies.size());
+    denominators.assign(numOfEnergies, 0);
+    if (numOfRuns == 0) {
+        return true;
+    }
+    // without any measurement every ln Z_k is -inf and the free energies would be NaN, they stay 0
+    if (numOfEnergies == 0) {
+        return false;
+    }
+    threads = std::clamp(threads, 1u, std::max(numOfEnergies, 1u));
+
+    // log-sum-exp of every run over the energies of every strip, as maximum and sum relative to it
+    std::vector<std::vector<double>> stripMax(threads, std::vector<double>(numOfRuns));
+    std::vector<std::vector<double>> stripSum(threads, std::vector<double>(numOfRuns));
+    unsigned int iterations = 0;
+    bool converged = false;
+    bool done = false;
+    runStrips(threads, [&](unsigned int strip, auto &sync) {
+        const unsigned int begin = stripBegin(strip, threads, numOfEnergies);
+        const unsigned int end = stripBegin(strip + 1, threads, numOfEnergies);
+        std::vector<double> terms(end - begin), logCounts(end - begin);
+        for (unsigned int e = begin; e < end; ++e) {
+            logCounts[e - begin] = std::log(binList[e].count);
+        }
+        while (true) {
+            logDenominators(begin, end, denominators);
+            // ln Z_k = ln sum_E g(E) exp(-E / T_k) with ln g(E) = ln H(E) - ln denominator(E)
+            for (size_t k = 0; k < numOfRuns; ++k) {
+                double largest = -std::numeric_limits<double>::infinity();
+                for (unsigned int e = begin; e < end; ++e) {
+                    terms[e - begin] = logCounts[e - begin] - denominators[e] - energies[e] / runTemps[k];
+                    largest = std::max(largest, terms[e - begin]);
+                }
+                double sum = 0;
+                for (unsigned int e = begin; e < end; ++e) {
+                    sum += std::exp(terms[e - begin] - largest);
+                }
+                stripMax[strip][k] = largest;
+                stripSum[strip][k] = sum;
+            }
+            sync.arrive_and_wait();
+            if (strip == 0) {
+                std::vector<double> next(numOfRuns);
+                for (size_t k = 0; k < numOfRuns; ++k) {
+                    double largest = -std::numeric_limits<double>::infinity();
+                    for (unsigned int s = 0; s < threads; ++s) {
+                        largest = std::max(largest, stripMax[s][k]);
+                    }
+                    double sum = 0;
+                    for (unsigned int s = 0; s < threads; ++s) {
+                        sum += stripSum[s][k] * std::exp(stripMax[s][k] - largest);
+                    }
+                    next[k] = -(largest + std::log(sum));
+                }
+                // only differences of the free energies matter
+                double change = 0;
+                for (size_t k = 0; k < numOfRuns; ++k) {
+                    change = std::max(change, std::abs(next[k] - next[0] - freeEnergies[k]));
+                    freeEnergies[k] = next[k] - next[0];
+                }
+                iterations++;
+                converged = change <= tolerance;
+                done = converged || iterations >= maxIterations;
+            }
+            sync.arrive_and_wait();
+            if (done) {
+                break;
+            }
+        }
+        logDenominators(begin, end, denominators);
+    });
+    return converged;
+}
+
+ReweightedPoint MultiHistogram::reweight(float temp, const std::vector<double> &logDenominator) const {
+    // weight of every measurement of a bin relative to the largest one: g(E) exp(-E / T) / H(E)
+    std::vector<double> weights(energies.size());
+    double largest = -std::numeric_limits<double>::infinity();
+    for (size_t e = 0; e < energies.size(); ++e) {
+        weights[e] = -logDenominator[e] - energies[e] / temp;
+        largest = std::max(largest, weights[e]);
+    }
+    double norm = 0, energy = 0, energySquared = 0, absM = 0, m2 = 0, m4 = 0;
+    for (size_t e = 0; e < energies.size(); ++e) {
+        const double weight = std::exp(weights[e] - largest);
+        const EnergyBin &bin = binList[e];
+        norm += weight * bin.count;
+        energy += weight * bin.energy;
+        energySquared += weight * bin.energySquared;
+        absM += weight * bin.absMagnetization;
+        m2 += weight * bin.magnetizationSquared;
+        m4 += weight * bin.magnetizationFourth;
+    }
+    energy /= norm, energySquared /= norm, absM /= norm, m2 /= norm, m4 /= norm;
+    const double numOfSpins = static_cast<double>(sights) * sights;
+    ReweightedPoint point{};
+    point.temp = temp;
+    point.meanEnergy = energy;
+    point.meanAbsMagnetization = absM;
+    point.meanMagnetizationSquared = m2;
+    point.meanMagnetizationFourth = m4;
+    point.heatCapacity = numOfSpins * (energySquared - energy * energy) / (static_cast<double>(temp) * temp);
+    point.susceptibility = numOfSpins * (m2 - absM * absM) / temp;
+    point.binderCumulant = m2 == 0 ? 0 : 1 - m4 / (3 * m2 * m2);
+    return point;
+}
+
+std::vector<ReweightedPoint> MultiHistogram::evaluate(const std::vector<float> &temps, unsigned int threads) const {
+    std::vector<ReweightedPoint> points(temps.size());
+    if (temps.empty() || binList.empty()) {
+        return points;
+    }
+    const auto numOfPoints = static_cast<unsigned int>(temps.size());
+    threads = std::clamp(threads, 1u, numOfPoints);
+    runStrips(threads, [&](unsigned int strip, auto &) {
+        for (unsigned int i = stripBegin(strip, threads, numOfPoints); i < stripBegin(strip + 1, threads, numOfPoints);
+             ++i) {
+            points[i] = reweight(temps[i], denominators);
+        }
+    });
+    return points;
+}
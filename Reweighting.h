@@ -0,0 +1,112 @@
+//
+// Created by chris on 17.10.26.
+//
+#pragma once
+
+#include "Histogram.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+/**
+ * observables of one temperature from reweighting, with the normalized energy E and magnetization M of
+ * SpinLattice2level
+ */
+struct ReweightedPoint {
+    float temp;
+    double meanEnergy;
+    double meanAbsMagnetization;
+    double meanMagnetizationSquared;
+    double meanMagnetizationFourth;
+    // N² var(E) / T² of the normalized energy E = 0.5 - J bondSum / (4N²) in [0, 1], like heatCap in
+    // results/postCalculationsMulti.mlx. The energy per spin is 4E - 2, so the heat capacity per spin is 16 times this.
+    double heatCapacity;
+    // N² var(|M|) / T, M is the magnetization per spin like suscept in results/postCalculationsMulti.mlx
+    double susceptibility;
+    // 1 - <M⁴> / (3 <M²>²)
+    double binderCumulant;
+};
+
+/**
+ * Multi-histogram reweighting (Ferrenberg-Swendsen, WHAM) of the measurements of one lattice size at several
+ * temperatures. The measurements are grouped by their total energy -J bondSum - h spinSum, so the work only depends on
+ * the number of different energies (at most about 2N²), not on the number of measurements.
+ *
+ * The density of states g(E) = H(E) / sum_k n_k exp(f_k - E / T_k) and the free energies f_k = -ln Z_k of the runs
+ * are solved self-consistently, with H(E) the measurements of energy E of all runs and n_k the measurements of run k.
+ * Everything is done in log space with log-sum-exp, the energies of large lattices would overflow exp otherwise.
+ * Every observable is then available at any temperature between the runs.
+ */
+class MultiHistogram {
+public:
+    MultiHistogram(unsigned int sights, int J, int h);
+
+    /**
+     * adds the measurements of one run, e.g. of ResultFile or Simulation::getBondSums and getSpinSums. The runs have to
+     * be equilibrated and should overlap in energy.
+     */
+    void addRun(float temp, const std::vector<long long> &bondSums, const std::vector<long long> &spinSums);
+
+    /**
+     * adds a run by its histogram, e.g. of Simulation::getHistograms. The same as adding its measurements.
+     */
+    void addRun(float temp, const JointHistogram &histogram);
+
+    /**
+     * iterates the self-consistent equations until no free energy changes more than the tolerance
+     * @param threads the energies are split into one strip per thread
+     * @return true if it converged within maxIterations, false if no run has measurements. Runs without measurements
+     * don't change the density of states, their free energy still follows from it.
+     */
+    bool solve(unsigned int threads, double tolerance = 1e-9, unsigned int maxIterations = 100000);
+
+    /**
+     * @return f_k = -ln Z_k of every run, f of the first run is 0. All 0 before solve.
+     */
+    [[nodiscard]] const std::vector<double> &getFreeEnergies() const {
+        return freeEnergies;
+    }
+
+    [[nodiscard]] const std::vector<float> &getTemps() const {
+        return runTemps;
+    }
+
+    /**
+     * reweights the observables to every given temperature after solve, in parallel
+     */
+    [[nodiscard]] std::vector<ReweightedPoint> evaluate(const std::vector<float> &temps, unsigned int threads) const;
+
+private:
+    // sums of the measurements with one total energy, over all runs
+    struct EnergyBin {
+        double count;
+        double energy;
+        double energySquared;
+        double absMagnetization;
+        double magnetizationSquared;
+        double magnetizationFourth;
+    };
+
+    // adds count measurements with these sums to the bin of their energy
+    void addToBin(long long bondSum, long long spinSum, std::uint64_t count);
+
+    // ln sum_k n_k exp(f_k - E / T_k) of every energy
+    void logDenominators(size_t begin, size_t end, std::vector<double> &result) const;
+
+    [[nodiscard]] ReweightedPoint reweight(float temp, const std::vector<double> &logDenominator) const;
+
+    unsigned int sights;
+    int J;
+    int h;
+    std::vector<float> runTemps;
+    std::vector<double> runCounts;
+    std::vector<double> freeEnergies;
+    // bins of all runs by total energy
+    std::map<long long, EnergyBin> bins;
+    // the bins as arrays for solve and evaluate
+    std::vector<double> energies;
+    std::vector<EnergyBin> binList;
+    std::vector<double> denominators;
+};
@@ -0,0 +1,270 @@
+//
+// Created by chris on 17.10.26.
+//
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <random>
+
+/**
+ * splitmix64: expands one 64-bit seed into well mixed words, used to initialize the state of the xoshiro generators
+ * @param state is advanced by every call
+ */
+inline std::uint64_t splitMix64(std::uint64_t &state) {
+    std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+/**
+ * Derives the seed of an independent stream from a master seed and a key, e.g. {N, temperature, chain}.
+ * Counter-based: the seed only depends on the master seed and the key, not on how many streams were derived before
+ * or on which thread, so every stream can be reproduced on its own.
+ */
+inline std::uint64_t deriveSeed(std::uint64_t masterSeed, std::initializer_list<std::uint64_t> key) {
+    std::uint64_t state = masterSeed;
+    std::uint64_t seed = splitMix64(state);
+    for (const auto k : key) {
+        state = seed ^ k;
+        seed = splitMix64(state);
+    }
+    return seed;
+}
+
+/**
+ * @return a non-deterministic seed from std::random_device
+ */
+inline std::uint64_t randomSeed() {
+    std::random_device rd;
+    return (static_cast<std::uint64_t>(rd()) << 32) ^ rd();
+}
+
+/**
+ * xoshiro256** by Blackman and Vigna (https://prng.di.unimi.it/): 32 bytes of state and a period of 2^256-1.
+ * It satisfies UniformRandomBitGenerator, so the distributions of <random> work with it as well.
+ */
+class Xoshiro256ss {
+public:
+    typedef std::uint64_t result_type;
+
+    explicit Xoshiro256ss(std::uint64_t seed = 0x2545F4914F6CDD1Dull) : s() {
+        this->seed(seed);
+    }
+
+    void seed(std::uint64_t seed) {
+        for (auto &word : s) {
+            word = splitMix64(seed);
+        }
+    }
+
+    static constexpr result_type min() {
+        return 0;
+    }
+
+    static constexpr result_type max() {
+        return UINT64_MAX;
+    }
+
+    inline result_type operator()() {
+        const std::uint64_t result = std::rotl(s[1] * 5, 7) * 9;
+        const std::uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = std::rotl(s[3], 45);
+        return result;
+    }
+
+    /**
+     * @return 32 random bits
+     */
+    inline std::uint32_t next32() {
+        return static_cast<std::uint32_t>(operator()() >> 32);
+    }
+
+    /**
+     * @return either 0 or 1
+     */
+    inline unsigned int bit() {
+        return static_cast<unsigned int>(operator()() >> 63);
+    }
+
+    /**
+     * @return a float between 0 and 1 (excluding 1)
+     */
+    inline float uniformFloat() {
+        return static_cast<float>(operator()() >> 40) * 0x1.0p-24f;
+    }
+
+    /**
+     * @return a double between 0 and 1 (excluding 1)
+     */
+    inline double uniformDouble() {
+        return static_cast<double>(operator()() >> 11) * 0x1.0p-53;
+    }
+
+    /**
+     * multiply-shift method of Lemire, the bias is below range / 2^32
+     * @return an integer between 0 and range-1
+     */
+    inline std::uint32_t bounded(std::uint32_t range) {
+        return static_cast<std::uint32_t>((static_cast<std::uint64_t>(next32()) * range) >> 32);
+    }
+
+    /**
+     * fills n 32-bit random numbers, e.g. for a whole row of a lattice
+     */
+    void fill(std::uint32_t *out, std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            out[i] = next32();
+        }
+    }
+
+    /**
+     * fills n floats between 0 and 1 (excluding 1)
+     */
+    void fill(float *out, std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            out[i] = uniformFloat();
+        }
+    }
+
+    /**
+     * advances the generator by 2^128 steps: every jump starts a new stream which doesn't overlap with the others
+     */
+    void jump() {
+        jump({0x180ec6d33cfd0abaull, 0xd5a61266f0c9392cull, 0xa9582618e03fc9aaull, 0x39abdc4529b1661cull});
+    }
+
+    /**
+     * advances the generator by 2^192 steps, e.g. for one stream of streams per thread
+     */
+    void longJump() {
+        jump({0x76e15d3efefdcbbfull, 0xc5004e441c522fb3ull, 0x77710069854ee241ull, 0x39109bb02acbe635ull});
+    }
+
+    [[nodiscard]] const std::array<std::uint64_t, 4> &state() const {
+        return s;
+    }
+
+private:
+    void jump(const std::array<std::uint64_t, 4> &polynomial) {
+        std::array<std::uint64_t, 4> jumped{};
+        for (const auto word : polynomial) {
+            for (unsigned int b = 0; b < 64; ++b) {
+                if (word & (std::uint64_t(1) << b)) {
+                    for (size_t i = 0; i < 4; ++i) {
+                        jumped[i] ^= s[i];
+                    }
+                }
+                operator()();
+            }
+        }
+        s = jumped;
+    }
+
+    std::array<std::uint64_t, 4> s;
+};
+
+/**
+ * Lanes xoshiro256** generators in a structure-of-arrays layout. All lanes are advanced with the same operations in
+ * one loop, which the compiler vectorizes (4 lanes per AVX2 and 8 per AVX-512 instruction), so whole rows of random
+ * numbers are much cheaper than one call after the other. Lane i starts i jumps (i * 2^128 steps) after the seed.
+ */
+template<std::size_t Lanes>
+class Xoshiro256ssBatch {
+public:
+    static constexpr std::size_t lanes = Lanes;
+
+    explicit Xoshiro256ssBatch(std::uint64_t seed = 0x2545F4914F6CDD1Dull) : s0(), s1(), s2(), s3() {
+        this->seed(seed);
+    }
+
+    void seed(std::uint64_t seed) {
+        Xoshiro256ss generator(seed);
+        for (std::size_t i = 0; i < Lanes; ++i) {
+            const auto &state = generator.state();
+            s0[i] = state[0];
+            s1[i] = state[1];
+            s2[i] = state[2];
+            s3[i] = state[3];
+            generator.jump();
+        }
+    }
+
+    /**
+     * Seeds the lanes with consecutive outputs of splitmix64 instead of jumps. Much cheaper than seed(), e.g. for a
+     * new stream for every block of a lattice. With a period of 2^256-1 the lanes overlap only with negligible
+     * probability.
+     */
+    void seedSplitMix(std::uint64_t seed) {
+        for (std::size_t i = 0; i < Lanes; ++i) {
+            s0[i] = splitMix64(seed);
+            s1[i] = splitMix64(seed);
+            s2[i] = splitMix64(seed);
+            s3[i] = splitMix64(seed);
+        }
+    }
+
+    /**
+     * advances all lanes
+     * @param out one random word per lane
+     */
+    inline void next(std::uint64_t *out) {
+        for (std::size_t i = 0; i < Lanes; ++i) {
+            // x * 5 and x * 9 as shifts, 64-bit multiplications don't vectorize with AVX2
+            const std::uint64_t x = s1[i] + (s1[i] << 2);
+            const std::uint64_t r = (x << 7) | (x >> 57);
+            out[i] = r + (r << 3);
+            const std::uint64_t t = s1[i] << 17;
+            s2[i] ^= s0[i];
+            s3[i] ^= s1[i];
+            s1[i] ^= s2[i];
+            s0[i] ^= s3[i];
+            s2[i] ^= t;
+            s3[i] = (s3[i] << 45) | (s3[i] >> 19);
+        }
+    }
+
+    /**
+     * fills n 32-bit random numbers. Every call starts with new words, the stream only depends on the sequence of n.
+     */
+    void fill(std::uint32_t *out, std::size_t n) {
+        std::uint64_t words[Lanes];
+        for (std::size_t i = 0; i < n; i += 2 * Lanes) {
+            next(words);
+            const std::size_t count = std::min(2 * Lanes, n - i);
+            for (std::size_t j = 0; j < count; ++j) {
+                out[i + j] = static_cast<std::uint32_t>(words[j / 2] >> (j % 2 == 0 ? 32 : 0));
+            }
+        }
+    }
+
+    /**
+     * fills n floats between 0 and 1 (excluding 1)
+     */
+    void fill(float *out, std::size_t n) {
+        std::uint64_t words[Lanes];
+        for (std::size_t i = 0; i < n; i += Lanes) {
+            next(words);
+            const std::size_t count = std::min(Lanes, n - i);
+            for (std::size_t j = 0; j < count; ++j) {
+                out[i + j] = static_cast<float>(words[j] >> 40) * 0x1.0p-24f;
+            }
+        }
+    }
+
+private:
+    std::uint64_t s0[Lanes];
+    std::uint64_t s1[Lanes];
+    std::uint64_t s2[Lanes];
+    std::uint64_t s3[Lanes];
+};
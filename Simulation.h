@@ -3,15 +3,66 @@
 //
 #pragma once
 
+#include "Histogram.h"
+#include "MeasurementWriter.h"
+#include "Moments.h"
 #include "SpinLattice2level.h"
+#include "SpinLattice2levelPacked.h"
+#include "Strips.h"
+#include "ThreadPool.h"
 
+#include <atomic>
+#include <bit>
 #include <chrono>
 #include <cmath>
+#include <condition_variable>
 #include <ctime>
 #include <fstream>
 #include <string>
 #include <thread>
 #include <iomanip>
+#include <memory>
+#include <numeric>
+#include <optional>
+
+/**
+ * std::atomic which can be copied, a copy gets the current value. Used for the members which are written by the
+ * workers and read by the status printer, so Simulation stays copyable.
+ */
+template<typename T>
+class CopyableAtomic : public std::atomic<T> {
+public:
+    CopyableAtomic(T value = T()) : std::atomic<T>(value) {}
+
+    CopyableAtomic(const CopyableAtomic &other) : std::atomic<T>(other.load()) {}
+
+    CopyableAtomic &operator=(const CopyableAtomic &other) {
+        this->store(other.load());
+        return *this;
+    }
+
+    using std::atomic<T>::operator=;
+};
+
+/**
+ * Markov algorithm of a Simulation
+ */
+enum class Algorithm {
+    Wolff,
+    SwendsenWang,
+    Metropolis,
+    HeatBath
+};
+
+/**
+ * lattice of the chains of simulate_seq, simulate_par and simulateAll
+ */
+enum class LatticeType {
+    // SpinLattice2level, one short per spin, all algorithms
+    Standard,
+    // SpinLattice2levelPacked, 64 spins per word: only Metropolis and heat-bath, N a multiple of 64
+    Packed
+};
 
 class Simulation {
 public:
@@ -22,14 +73,19 @@ public:
      * @param tempStart
      * @param tempEnd
      * @param numIterations
-     * @param shuffleAgainAfter this leads to reinitialize the spins after given number. Set to UINT32_MAX if you would like to use always the same ensemble
+     * @param shuffleAgainAfter this leads to reinitialize the spins after given number of iterations of one
+     * temperature, every temperature starts with new random spins. Set to UINT32_MAX if you would like to use always
+     * the same ensemble per temperature
      */
     Simulation(unsigned int sights, unsigned int numOfTemps, float tempStart, float tempEnd, unsigned int numIterations,
                unsigned int shuffleAgainAfter)
-            : thermalizeSweeps(10), sweepsPerIteration(1), sights(sights), tempStart(tempStart), tempEnd(tempEnd),
-              numOfTemps(numOfTemps), numOfIterations(numIterations), shuffleAgainAfter(shuffleAgainAfter),
-              tempIndexATM(0), amountOfThreads(1), amountOfWorkingThreads(0), printStat(true), sl(sights),
-              isSimulated(false) {
+            : thermalizeSweeps(10), sweepsPerIteration(1), seed(randomSeed()), algorithm(Algorithm::Wolff),
+              sweepOrder(SweepOrder::RowMajor), threadsPerLattice(1), latticeType(LatticeType::Standard),
+              swapInterval(1), chainsPerTemp(1), priority(0), statusInterval(std::chrono::seconds(20)),
+              writer(nullptr), keepMeasurements(true), collectHistograms(false), sights(sights), tempStart(tempStart),
+              tempEnd(tempEnd), numOfTemps(numOfTemps), numOfIterations(numIterations),
+              shuffleAgainAfter(shuffleAgainAfter), tempIndexATM(0), amountOfThreads(1), amountOfWorkingThreads(0),
+              printStat(true), sl(sights), isSimulated(false) {
         // reserve memory for results
         temps.reserve(numOfTemps * numOfIterations);
         energies.reserve(numOfTemps * numOfIterations);
@@ -37,7 +93,8 @@ public:
 
         // calculate temps
         for (unsigned int i = 0; i < numOfTemps; ++i) {
-            float temp = tempStart + static_cast<float>(i) * (tempEnd - tempStart) / static_cast<float>(numOfTemps - 1);
+            float temp = numOfTemps == 1 ? tempStart : tempStart + static_cast<float>(i) * (tempEnd - tempStart) /
+                                                                   static_cast<float>(numOfTemps - 1);
             for (unsigned int j = 0; j < numOfIterations; ++j) {
                 temps.push_back(temp);
             }
@@ -48,23 +105,27 @@ public:
         if (isSimulated) {
             std::cerr << "This simulation is already finished.\n";
         } else {
+            amountOfThreads = 1;
             amountOfWorkingThreads = 1;
-            for (unsigned int i = 0; i < temps.size(); i++) {
-                // shuffle sl to obtain maybe a different equilibrate state
-                if (i % shuffleAgainAfter == 0) {
-                    sl.initRandom();
-                    wolffSweep(sl, temps[i], thermalizeSweeps);
+            prepareResults();
+            configure(sl);
+            {
+                StatusPrinter printer({this});
+                std::optional<SpinLattice2levelPacked> packed;
+                if (latticeType == LatticeType::Packed) {
+                    packed.emplace(sights);
                 }
-                if (printStat && i % 10000 == 0) {
-                    printStatus();
+                for (unsigned int t = 0; t < numOfTemps; ++t) {
+                    for (unsigned int chain = 0; chain < numOfChains(); ++chain) {
+                        if (packed) {
+                            simulateChain(*packed, t, chain);
+                        } else {
+                            simulateChain(sl, t, chain);
+                        }
+                    }
                 }
-
-                wolffSweep(sl, temps[i], sweepsPerIteration);
-                energies.push_back(sl.calcEnergy());
-                magnetization.push_back(sl.calcMagnetization());
-                tempIndexATM++;
-
             }
+            tempIndexATM = temps.size();
             isSimulated = true;
             amountOfWorkingThreads = 0;
         }
@@ -72,99 +133,138 @@ public:
 
 
     /**
- * simulate the simulation parallelized
- */
+     * simulate the simulation parallelized: every chain of every temperature is a task on the sharedPool with its own
+     * lattice. The expensive tasks are submitted first (see estimatedCost), the results are stored in the order of the
+     * temperatures like with simulate_seq.
+     */
     void simulate_par() {
-        // -------------- Divide amount of work -------------------------------------------------
-        static const unsigned int hardwareCon = std::thread::hardware_concurrency();
-        static const unsigned int supportedThreads = hardwareCon == 0 ? 2 : hardwareCon;
-
-        const unsigned int workPerThread = numOfTemps / supportedThreads;
-        const unsigned int workRemaining = numOfTemps % supportedThreads;
-
-        if (workPerThread == 0 && workRemaining > 0) //we have less work than threads
-            amountOfThreads = numOfTemps;
-        else //we have enough work --> use all cores
-            amountOfThreads = supportedThreads;
-        //TODO split up remaining work to all cores, not only the last one
-        std::cout << amountOfThreads << " threads will be used for calculation." << std::endl;
-        // --------------------------------------------------------------------------------------
-
-
-        /// Create now data structure to divide and store work: initialize different ensembles
-        // TODO shuffle temperatures bec. different temps may take different simulation time (see Wolff for low vs high T)
-        std::vector<Simulation> Sims;
-        Sims.reserve(amountOfThreads);
-        float tempStep = (tempEnd - tempStart) / static_cast<float>(numOfTemps - 1);
-        for (unsigned int i = 0; i < amountOfThreads; ++i) {
-            float startTemp = tempStart + static_cast<float>(i * workPerThread) * tempStep;
-            float endTemp;
-
-            if (i == amountOfThreads - 1) {//this is the last case, include the rest now
-                Sims.emplace_back(sights, workPerThread + workRemaining, startTemp, tempEnd, numOfIterations,
-                                  shuffleAgainAfter);
+        if (isSimulated) {
+            std::cerr << "This simulation is already finished.\n";
+            return;
+        }
+        runTasks({this});
+    }
+
+    /**
+     * Simulates all given simulations parallelized as one batch on the sharedPool, so the cores of a small lattice
+     * which finished early work on the larger lattices. The tasks (one per chain of every temperature) start ordered
+     * by the priority of their simulation, then by estimatedCost, both descending. The results are the same as with
+     * simulate_par or simulate_seq of every simulation. Simulations which are already finished are skipped.
+     */
+    static void simulateAll(std::vector<Simulation> &sims) {
+        std::vector<Simulation *> pending;
+        for (auto &S : sims) {
+            if (S.isSimulated) {
+                std::cerr << "The simulation N=" << S.sights << " is already finished.\n";
             } else {
-                endTemp = tempStart + static_cast<float>((i + 1) * workPerThread - 1) * tempStep;
-                Sims.emplace_back(sights, workPerThread, startTemp, endTemp, numOfIterations, shuffleAgainAfter);
+                pending.push_back(&S);
             }
-            // deactivate std::cout of those sims
-            Sims.back().printStat = false;
-
-        }
-#ifdef DEBUG
-        for (const auto &s:Sims) {
-            std::cout.precision(3);
-            std::cout << "Simulate from tS=" << s.getTempStart() << "\tuntil tE=" << s.getTempEnd() << "\twith\t"
-                      << s.getNumOfTemps() << " temps, temps.size()=\t" << s.getTemps().size() << std::endl;
         }
-#endif
+        runTasks(pending);
+    }
 
-        //start threads
-        std::vector<std::thread> threads(amountOfThreads);
-        for (unsigned int i = 0; i < threads.size(); i++) {
-            threads[i] = std::thread([&Sims, i]() { Sims[i].simulate_seq(); });
+    /**
+     * Parallel tempering (replica exchange): one lattice per temperature, all lattices are updated in parallel.
+     * Every swapInterval iterations the neighbouring temperatures try to exchange their lattices with probability
+     * min(1, exp((1/T_i - 1/T_j) * (E_i - E_j))), alternating between the even and the odd pairs.
+     * The measurements are stored per temperature like with simulate_seq, shuffleAgainAfter and chainsPerTemp are not
+     * used.
+     */
+    void simulate_pt() {
+        if (isSimulated) {
+            std::cerr << "This simulation is already finished.\n";
+            return;
         }
-
-        amountOfWorkingThreads = amountOfThreads;
-        // Let threads initialize first
-        printStatus();
-        std::this_thread::sleep_for(std::chrono::seconds(20));
-
-        while (amountOfWorkingThreads > 0) {
-            tempIndexATM = 0;
-            amountOfWorkingThreads = 0;
-            for (auto &s : Sims) {
-                amountOfWorkingThreads += s.amountOfWorkingThreads;
-                tempIndexATM += s.tempIndexATM;
-            }
-            tempIndexATM = std::min(tempIndexATM, temps.size() - 1);
-            printStatus();
-            std::this_thread::sleep_for(std::chrono::seconds(20));
+        std::vector<float> ladder(numOfTemps);
+        std::vector<SpinLattice2level> replicas;
+        replicas.reserve(numOfTemps);
+        for (unsigned int t = 0; t < numOfTemps; ++t) {
+            ladder[t] = temps[t * numOfIterations];
+            replicas.emplace_back(sights);
+            configure(replicas.back());
+            replicas.back().seed(deriveSeed(seed, {sights, std::bit_cast<std::uint32_t>(ladder[t])}));
+            replicas.back().initRandom();
         }
-
-        for (auto &i : threads) {
-            i.join();
+        // lattice at every temperature, swaps only exchange these indices
+        std::vector<unsigned int> replicaOfTemp(numOfTemps);
+        std::iota(replicaOfTemp.begin(), replicaOfTemp.end(), 0);
+        Xoshiro256ss swapRng(deriveSeed(seed, {sights, swapStreamKey}));
+        swapAttempts.assign(numOfTemps > 0 ? numOfTemps - 1 : 0, 0);
+        swapAccepts.assign(swapAttempts.size(), 0);
+        energies.assign(writer == nullptr && keepMeasurements ? temps.size() : 0, 0);
+        magnetization.assign(energies.size(), 0);
+        bondSums.assign(energies.size(), 0);
+        spinSums.assign(energies.size(), 0);
+        chains.assign(energies.size(), 0);
+        // the memory reserved by the constructor isn't needed without measurements
+        energies.shrink_to_fit();
+        magnetization.shrink_to_fit();
+        chainMoments.assign(numOfTemps, ObservableMoments());
+        chainHistograms.assign(collectHistograms ? numOfTemps : 0, JointHistogram(sights));
+        tempIndexATM = 0;
+        // one channel per temperature, only used by the worker of the temperature
+        registerBlocks(1);
+        std::vector<std::unique_ptr<MeasurementWriter::Channel>> channels(writer == nullptr ? 0 : numOfTemps);
+        for (size_t t = 0; t < channels.size(); ++t) {
+            channels[t] = std::make_unique<MeasurementWriter::Channel>(*writer, writerBlocks[t], 0, 0);
         }
 
-        for (const auto &Simulations:Sims) {
-            //TODO check if measurements correspond to temps
-#ifdef DEBUG
-            std::cout << "Simulations.getTemps().size()=" << Simulations.getTemps().size() << std::endl;
-#endif
-            energies.insert(energies.end(), Simulations.getEnergies().begin(), Simulations.getEnergies().end());
-            magnetization.insert(end(magnetization), Simulations.getMagnetization().begin(),
-                                 Simulations.getMagnetization().end());
-        }
+        static const unsigned int hardwareCon = std::thread::hardware_concurrency();
+        amountOfThreads = std::clamp(hardwareCon, 1u, std::max(numOfTemps, 1u));
+        amountOfWorkingThreads = amountOfThreads.load();
+        const unsigned int workers = amountOfThreads;
+
+        StatusPrinter printer({this});
+        runStrips(workers, [&](unsigned int worker, auto &sync) {
+            const unsigned int begin = stripBegin(worker, workers, numOfTemps);
+            const unsigned int end = stripBegin(worker + 1, workers, numOfTemps);
+            for (unsigned int t = begin; t < end; ++t) {
+                sweep(replicas[replicaOfTemp[t]], ladder[t], thermalizeSweeps);
+            }
+            for (unsigned int iteration = 0; iteration < numOfIterations; ++iteration) {
+                for (unsigned int t = begin; t < end; ++t) {
+                    auto &replica = replicas[replicaOfTemp[t]];
+                    sweep(replica, ladder[t], sweepsPerIteration);
+                    chainMoments[t].add(replica.getBondSum(), replica.getSpinSum(), replica.J, sights);
+                    if (collectHistograms) {
+                        chainHistograms[t].add(replica.getBondSum(), replica.getSpinSum());
+                    }
+                    if (writer != nullptr) {
+                        channels[t]->push(replica.getBondSum(), replica.getSpinSum());
+                    } else if (keepMeasurements) {
+                        store(t * numOfIterations + iteration, replica.getBondSum(), replica.getSpinSum(), replica.J);
+                    }
+                }
+                sync.arrive_and_wait();
+                if (worker == 0) {
+                    if ((iteration + 1) % swapInterval == 0) {
+                        attemptSwaps(replicas, replicaOfTemp, ladder, (iteration / swapInterval) % 2, swapRng);
+                    }
+                    tempIndexATM = static_cast<unsigned long>(iteration + 1) * numOfTemps;
+                }
+                sync.arrive_and_wait();
+            }
+        });
+        tempIndexATM = temps.size();
+        amountOfWorkingThreads = 0;
         isSimulated = true;
-#ifdef DEBUG
-        if(temps.size()!=numOfTemps*numOfIterations){
-            std::cerr<<"results size not matched!\n";
-            exit(15);
-        }
-#endif
+    }
 
+    /**
+     * @return acceptance rate of the swaps between the temperatures t and t+1 of simulate_pt
+     */
+    [[nodiscard]] std::vector<float> getSwapAcceptance() const {
+        std::vector<float> rates(swapAttempts.size());
+        for (size_t t = 0; t < rates.size(); ++t) {
+            rates[t] = swapAttempts[t] == 0 ? 0 : static_cast<float>(swapAccepts[t]) /
+                                                  static_cast<float>(swapAttempts[t]);
+        }
+        return rates;
     }
 
+    [[nodiscard]] const std::vector<unsigned long> &getSwapAttempts() const {
+        return swapAttempts;
+    }
 
     [[nodiscard]] unsigned int getSights() const {
         return sights;
@@ -186,6 +286,10 @@ public:
         return numOfIterations;
     }
 
+    [[nodiscard]] std::uint64_t getSeed() const {
+        return seed;
+    }
+
     [[nodiscard]] unsigned int getShuffleAgainAfter() const {
         return shuffleAgainAfter;
     }
@@ -194,6 +298,9 @@ public:
         return temps;
     }
 
+    /**
+     * @return measurements in the order of getTemps, empty if they were streamed to a writer or not kept
+     */
     [[nodiscard]] const std::vector<float> &getEnergies() const {
         return energies;
     }
@@ -202,6 +309,120 @@ public:
         return magnetization;
     }
 
+    /**
+     * @return exact sum over all bonds of every measurement, getEnergies is calculated from it
+     */
+    [[nodiscard]] const std::vector<long long> &getBondSums() const {
+        return bondSums;
+    }
+
+    /**
+     * @return exact sum over all spins of every measurement, getMagnetization is calculated from it
+     */
+    [[nodiscard]] const std::vector<long long> &getSpinSums() const {
+        return spinSums;
+    }
+
+    /**
+     * @return chain of every measurement, the measurements of one chain are consecutive. Only filled after a run.
+     */
+    [[nodiscard]] const std::vector<unsigned int> &getChains() const {
+        return chains;
+    }
+
+    /**
+     * Moments of every temperature, accumulated while the simulation runs from the exact sums of every measurement,
+     * also if the measurements are streamed or not kept. The chains of a temperature are merged in their order, so
+     * the summary is the same with simulate_seq and simulate_par. The errors of the means come from the binning of
+     * the measurements, the bins of all chains are pooled.
+     * @return one summary per temperature, empty before a run
+     */
+    [[nodiscard]] std::vector<ThermoSummary> getSummary() const {
+        std::vector<ThermoSummary> summary;
+        if (chainMoments.empty()) {
+            return summary;
+        }
+        const size_t chainsOfRun = chainMoments.size() / numOfTemps;
+        for (unsigned int t = 0; t < numOfTemps; ++t) {
+            ObservableMoments moments;
+            for (size_t chain = 0; chain < chainsOfRun; ++chain) {
+                moments.merge(chainMoments[t * chainsOfRun + chain]);
+            }
+            summary.push_back(moments.summarize(temps[static_cast<size_t>(t) * numOfIterations], sights));
+        }
+        return summary;
+    }
+
+    /**
+     * writes getSummary as a table with the columns N, temp, count, energy, energy², |magnetization|,
+     * magnetization², magnetization⁴, heatCapacity, susceptibility, binderCumulant and the error, tau and number of
+     * independent measurements of energy and |magnetization|
+     * @param header write a line with the column names first
+     */
+    void writeSummary(std::ostream &out, bool header) const {
+        if (header) {
+            out << "N\ttemp\tcount\tenergy\tenergySquared\tabsMagnetization\tmagnetizationSquared"
+                   "\tmagnetizationFourth\theatCapacity\tsusceptibility\tbinderCumulant"
+                   "\tenergyError\tenergyTau\tenergySamples\tabsMagnetizationError\tabsMagnetizationTau"
+                   "\tabsMagnetizationSamples\n";
+        }
+        const auto flags = out.flags();
+        const auto precision = out.precision();
+        out << std::setprecision(10);
+        for (const auto &row : getSummary()) {
+            out << sights << '\t' << row.temp << '\t' << row.count << '\t' << row.meanEnergy << '\t'
+                << row.meanEnergySquared << '\t' << row.meanAbsMagnetization << '\t' << row.meanMagnetizationSquared
+                << '\t' << row.meanMagnetizationFourth << '\t' << row.heatCapacity << '\t' << row.susceptibility
+                << '\t' << row.binderCumulant;
+            for (const auto &binning : {row.energyBinning, row.absMagnetizationBinning}) {
+                out << '\t' << binning.error << '\t' << binning.tau << '\t' << binning.effectiveSamples;
+            }
+            out << '\n';
+        }
+        out.flags(flags);
+        out.precision(precision);
+    }
+
+    /**
+     * Joint histograms of (bond sum, spin sum) of every temperature, collected while the simulation runs if
+     * collectHistograms is set, also if the measurements are streamed or not kept. The chains of a temperature are
+     * merged, see MultiHistogram::addRun to reweight them.
+     * @return one histogram per temperature, empty before a run or without collectHistograms
+     */
+    [[nodiscard]] std::vector<JointHistogram> getHistograms() const {
+        std::vector<JointHistogram> histograms;
+        if (chainHistograms.empty()) {
+            return histograms;
+        }
+        const size_t chainsOfRun = chainHistograms.size() / numOfTemps;
+        for (unsigned int t = 0; t < numOfTemps; ++t) {
+            histograms.push_back(chainHistograms[t * chainsOfRun]);
+            for (size_t chain = 1; chain < chainsOfRun; ++chain) {
+                histograms.back().merge(chainHistograms[t * chainsOfRun + chain]);
+            }
+        }
+        return histograms;
+    }
+
+    /**
+     * writes getHistograms as a table with the columns N, temp, bondSum, spinSum and count, one row per visited
+     * (bond sum, spin sum) of every temperature
+     * @param header write a line with the column names first
+     */
+    void writeHistograms(std::ostream &out, bool header) const {
+        if (header) {
+            out << "N\ttemp\tbondSum\tspinSum\tcount\n";
+        }
+        const auto histograms = getHistograms();
+        for (unsigned int t = 0; t < histograms.size(); ++t) {
+            const float temp = temps[static_cast<size_t>(t) * numOfIterations];
+            for (const auto &entry : histograms[t].getEntries()) {
+                out << sights << '\t' << temp << '\t' << entry.bondSum << '\t' << entry.spinSum << '\t'
+                    << entry.count << '\n';
+            }
+        }
+    }
+
     /**
      * prints status of simulation to console
      */
@@ -212,6 +433,7 @@ public:
 
         const std::string sep = " | ";
         const std::string tempSize = std::string(std::to_string(temps.size()));
+        const unsigned long index = std::min<unsigned long>(tempIndexATM, temps.size() - 1);
 
         const auto time = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
         const std::string timeString = std::string(std::ctime(&time));
@@ -219,11 +441,11 @@ public:
 
         std::cout << sep << "N=" << std::left << std::setw(5) << sights
                   << sep << "run:" << std::right << std::setw(static_cast<int>(tempSize.size()))
-                  << tempIndexATM + 1 << "/" << std::left << temps.size()
+                  << index + 1 << "/" << std::left << temps.size()
 
-                  << sep << "T=" << std::setprecision(3) << std::setw(6) << temps[tempIndexATM]
+                  << sep << "T=" << std::setprecision(3) << std::setw(6) << temps[index]
                   << sep << std::setprecision(4) << std::setw(6)
-                  << static_cast<float>(tempIndexATM * 100) / static_cast<float>(temps.size() - 1) << "%"
+                  << static_cast<float>(index * 100) / static_cast<float>(temps.size() - 1) << "%"
 
                   << sep << "threads: " << std::right << std::setw(3)
                   << amountOfWorkingThreads << "/" << std::left << amountOfThreads
@@ -232,9 +454,382 @@ public:
                   << sep << '\n';
     }
 
+private:
+    /**
+     * Prints the status of the given simulations with printStat on an own thread, every statusInterval (the shortest
+     * of them) while they have working threads. Stops as soon as it is destroyed.
+     */
+    class StatusPrinter {
+    public:
+        explicit StatusPrinter(std::vector<const Simulation *> sims) : sims(std::move(sims)), stop(false) {
+            auto interval = std::chrono::milliseconds::max();
+            for (const auto *S : this->sims) {
+                interval = std::min(interval, S->statusInterval);
+            }
+            printer = std::thread([this, interval]() { print(interval); });
+        }
+
+        StatusPrinter(const StatusPrinter &) = delete;
+
+        StatusPrinter &operator=(const StatusPrinter &) = delete;
+
+        ~StatusPrinter() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+            }
+            wake.notify_all();
+            printer.join();
+        }
+
+    private:
+        void print(std::chrono::milliseconds interval) {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (!wake.wait_for(lock, interval, [this]() { return stop; })) {
+                for (const auto *S : sims) {
+                    if (S->printStat && S->amountOfWorkingThreads > 0) {
+                        S->printStatus();
+                    }
+                }
+            }
+        }
+
+        std::vector<const Simulation *> sims;
+        std::mutex mutex;
+        std::condition_variable wake;
+        bool stop;
+        std::thread printer;
+    };
+
+    /**
+     * @return number of chains per temperature, every chain gets at least one iteration
+     */
+    [[nodiscard]] unsigned int numOfChains() const {
+        return std::clamp(chainsPerTemp, 1u, std::max(numOfIterations, 1u));
+    }
+
+    /**
+     * sizes the measurements and numbers the chains
+     */
+    void prepareResults() {
+        if (latticeType == LatticeType::Packed &&
+            (sights % 64 != 0 || (algorithm != Algorithm::Metropolis && algorithm != Algorithm::HeatBath))) {
+            std::cerr << "The packed lattice needs Metropolis or heat-bath and a multiple of 64 sights, got N="
+                      << sights << ".\n";
+            exit(16);
+        }
+        tempIndexATM = 0;
+        // streamed measurements are not kept
+        energies.assign(writer == nullptr && keepMeasurements ? temps.size() : 0, 0);
+        magnetization.assign(energies.size(), 0);
+        bondSums.assign(energies.size(), 0);
+        spinSums.assign(energies.size(), 0);
+        chains.assign(energies.size(), 0);
+        // the memory reserved by the constructor isn't needed without measurements
+        energies.shrink_to_fit();
+        magnetization.shrink_to_fit();
+        for (size_t i = 0, chain = 0; i < chains.size(); ++i) {
+            const unsigned int iteration = i % numOfIterations;
+            if (iteration == 0) {
+                chain = 0;
+            } else if (iteration == stripBegin(chain + 1, numOfChains(), numOfIterations)) {
+                chain++;
+            }
+            chains[i] = static_cast<unsigned int>(chain);
+        }
+        chainMoments.assign(static_cast<size_t>(numOfTemps) * numOfChains(), ObservableMoments());
+        chainHistograms.assign(collectHistograms ? chainMoments.size() : 0, JointHistogram(sights));
+        registerBlocks(numOfChains());
+    }
+
+    /**
+     * applies the options of the lattices (sweepOrder, threadsPerLattice) to a lattice of this simulation
+     */
+    void configure(SpinLattice2level &lattice) const {
+        lattice.sweepOrder = sweepOrder;
+        lattice.threads = threadsPerLattice;
+    }
+
+    /**
+     * stores the measurement i of a lattice
+     */
+    void store(size_t i, long long bondSum, long long spinSum, int J) {
+        energies[i] = SpinLattice2level::normalizedEnergy(bondSum, J, sights);
+        magnetization[i] = SpinLattice2level::normalizedMagnetization(spinSum, sights);
+        bondSums[i] = bondSum;
+        spinSums[i] = spinSum;
+    }
+
+    /**
+     * registers one block per temperature at the writer, if there is one
+     */
+    void registerBlocks(unsigned int numOfChainsPerTemp) {
+        writerBlocks.clear();
+        for (unsigned int t = 0; writer != nullptr && t < numOfTemps; ++t) {
+            ResultBlock block{};
+            block.sights = sights;
+            block.temp = temps[static_cast<size_t>(t) * numOfIterations];
+            block.algorithm = static_cast<std::uint32_t>(algorithm);
+            block.sweepsPerIteration = sweepsPerIteration;
+            block.thermalizeSweeps = thermalizeSweeps;
+            block.chains = numOfChainsPerTemp;
+            block.J = sl.J;
+            block.h = sl.getH();
+            block.seed = seed;
+            block.count = numOfIterations;
+            writerBlocks.push_back(writer->addBlock(block));
+        }
+    }
+
+    /**
+     * Runs one Markov chain of one temperature. The iterations of a temperature are split evenly into numOfChains()
+     * chains, every chain starts with new random spins and is thermalized on its own. Every chain has an own stream
+     * derived from (seed, N, T, chain), chain 0 from (seed, N, T), so its results don't depend on the other chains,
+     * the other temperatures or the number of threads.
+     * @param t index of the temperature, the measurements are written to t * numOfIterations and following
+     * @param chain index of the chain, its measurements follow the measurements of the chains before
+     */
+    template<typename Lattice>
+    void simulateChain(Lattice &lattice, unsigned int t, unsigned int chain) {
+        const size_t first = static_cast<size_t>(t) * numOfIterations +
+                             stripBegin(chain, numOfChains(), numOfIterations);
+        const unsigned int length = stripBegin(chain + 1, numOfChains(), numOfIterations) -
+                                    stripBegin(chain, numOfChains(), numOfIterations);
+        const float temp = temps[first];
+        const auto tempKey = std::bit_cast<std::uint32_t>(temp);
+        lattice.seed(chain == 0 ? deriveSeed(seed, {sights, tempKey}) : deriveSeed(seed, {sights, tempKey, chain}));
+        std::optional<MeasurementWriter::Channel> channel;
+        if (writer != nullptr) {
+            channel.emplace(*writer, writerBlocks[t], chain, stripBegin(chain, numOfChains(), numOfIterations));
+        }
+        // only this chain adds to its moments
+        ObservableMoments &moments = chainMoments[static_cast<size_t>(t) * numOfChains() + chain];
+        JointHistogram *histogram = nullptr;
+        if (collectHistograms) {
+            histogram = &chainHistograms[static_cast<size_t>(t) * numOfChains() + chain];
+        }
+        for (unsigned int iteration = 0; iteration < length; ++iteration) {
+            // shuffle the lattice to obtain maybe a different equilibrate state
+            if (iteration % shuffleAgainAfter == 0) {
+                lattice.initRandom();
+                sweep(lattice, temp, thermalizeSweeps);
+            }
+            sweep(lattice, temp, sweepsPerIteration);
+            // O(1) for SpinLattice2level, counted once per measurement for the packed lattice
+            const long long bondSum = lattice.getBondSum();
+            const long long spinSum = lattice.getSpinSum();
+            moments.add(bondSum, spinSum, lattice.J, sights);
+            if (histogram != nullptr) {
+                histogram->add(bondSum, spinSum);
+            }
+            if (channel) {
+                channel->push(bondSum, spinSum);
+            } else if (keepMeasurements) {
+                store(first + iteration, bondSum, spinSum, lattice.J);
+            }
+            tempIndexATM++;
+        }
+    }
+
+    /**
+     * Rough cost of a chain in spin updates, only used to start the expensive tasks first. Metropolis, heat-bath and
+     * Swendsen-Wang visit every site per sweep. A Wolff cluster covers the fraction m^2 of the lattice below T_c
+     * (Onsager's m) and about xi^(7/4) sites above, with the correlation length xi ~ T_c / (T - T_c) at most N.
+     */
+    [[nodiscard]] double estimatedCost(unsigned int t, unsigned int chain) const {
+        const double sites = static_cast<double>(sights) * sights;
+        const double temp = temps[static_cast<size_t>(t) * numOfIterations];
+        const unsigned int length = stripBegin(chain + 1, numOfChains(), numOfIterations) -
+                                    stripBegin(chain, numOfChains(), numOfIterations);
+        const double shuffles = std::ceil(static_cast<double>(length) / shuffleAgainAfter);
+        const double sweeps = shuffles * thermalizeSweeps + static_cast<double>(length) * sweepsPerIteration;
+        if (algorithm != Algorithm::Wolff) {
+            return sweeps * sites;
+        }
+        const double tc = 2.0 / std::log(1.0 + std::sqrt(2.0));
+        double clusterSize;
+        if (temp < tc) {
+            const double m = std::pow(1.0 - std::pow(std::sinh(2.0 / temp), -4.0), 0.125);
+            clusterSize = sites * m * m;
+        } else {
+            clusterSize = std::pow(std::min<double>(sights, tc / (temp - tc)), 1.75);
+        }
+        return sweeps * std::clamp(clusterSize, 1.0, sites);
+    }
+
+    /**
+     * runs all chains of the given simulations on the sharedPool, returns as soon as the last chain is finished
+     */
+    static void runTasks(const std::vector<Simulation *> &sims) {
+        struct Task {
+            size_t sim;
+            unsigned int t;
+            unsigned int chain;
+            int priority;
+            double cost;
+        };
+        std::vector<Task> tasks;
+        for (size_t i = 0; i < sims.size(); ++i) {
+            Simulation *S = sims[i];
+            S->prepareResults();
+            for (unsigned int t = 0; t < S->numOfTemps; ++t) {
+                for (unsigned int chain = 0; chain < S->numOfChains(); ++chain) {
+                    tasks.push_back({i, t, chain, S->priority, S->estimatedCost(t, chain)});
+                }
+            }
+        }
+        std::stable_sort(tasks.begin(), tasks.end(), [](const Task &a, const Task &b) {
+            return a.priority != b.priority ? a.priority > b.priority : a.cost > b.cost;
+        });
+
+        ThreadPool &pool = sharedPool();
+        for (auto *S : sims) {
+            S->amountOfThreads = std::min(pool.size(), S->numOfTemps * S->numOfChains());
+        }
+        std::cout << std::min<size_t>(pool.size(), tasks.size()) << " threads will be used for calculation."
+                  << std::endl;
+        {
+            StatusPrinter printer({sims.begin(), sims.end()});
+            TaskGroup group(pool);
+            for (const auto &task : tasks) {
+                Simulation *S = sims[task.sim];
+                group.submit([S, task]() {
+                    S->amountOfWorkingThreads++;
+                    if (S->latticeType == LatticeType::Packed) {
+                        SpinLattice2levelPacked lattice(S->sights);
+                        S->simulateChain(lattice, task.t, task.chain);
+                    } else {
+                        SpinLattice2level lattice(S->sights);
+                        S->configure(lattice);
+                        S->simulateChain(lattice, task.t, task.chain);
+                    }
+                    S->amountOfWorkingThreads--;
+                });
+            }
+            group.wait();
+        }
+        for (auto *S : sims) {
+            S->tempIndexATM = S->temps.size();
+            S->amountOfWorkingThreads = 0;
+            S->isSimulated = true;
+        }
+    }
+
+    /**
+     * runs the chosen algorithm
+     * @param sweeps number of sweeps (clusters for Wolff)
+     */
+    void sweep(SpinLattice2level &lattice, float temp, unsigned int sweeps) const {
+        switch (algorithm) {
+            case Algorithm::SwendsenWang:
+                swendsenWangSweep(lattice, temp, sweeps);
+                break;
+            case Algorithm::Metropolis:
+                metropolisSweep(lattice, temp, sweeps);
+                break;
+            case Algorithm::HeatBath:
+                heatBathSweep(lattice, temp, sweeps);
+                break;
+            default:
+                wolffSweep(lattice, temp, sweeps);
+        }
+    }
+
+    /**
+     * runs Metropolis or heat-bath on the packed lattice, prepareResults rejects the other algorithms
+     */
+    void sweep(SpinLattice2levelPacked &lattice, float temp, unsigned int sweeps) const {
+        if (algorithm == Algorithm::HeatBath) {
+            heatBathSweep(lattice, temp, sweeps);
+        } else {
+            metropolisSweep(lattice, temp, sweeps);
+        }
+    }
+
+    /**
+     * tries to swap the lattices of the pairs (t, t+1) with t = parity, parity + 2, ...
+     */
+    void attemptSwaps(const std::vector<SpinLattice2level> &replicas, std::vector<unsigned int> &replicaOfTemp,
+                      const std::vector<float> &ladder, unsigned int parity, Xoshiro256ss &rng) {
+        for (unsigned int t = parity; t + 1 < numOfTemps; t += 2) {
+            const double energyDiff = static_cast<double>(replicas[replicaOfTemp[t]].getTotalEnergy() -
+                                                          replicas[replicaOfTemp[t + 1]].getTotalEnergy());
+            const double exponent = (1.0 / ladder[t] - 1.0 / ladder[t + 1]) * energyDiff;
+            swapAttempts[t]++;
+            if (exponent >= 0 || rng.uniformDouble() < std::exp(exponent)) {
+                std::swap(replicaOfTemp[t], replicaOfTemp[t + 1]);
+                swapAccepts[t]++;
+            }
+        }
+    }
+
+    // key of the random stream of the swaps, the lattices use (seed, N, T)
+    static constexpr std::uint64_t swapStreamKey = 0x5357415053ull;
+
 public:
     unsigned int thermalizeSweeps;
     unsigned int sweepsPerIteration;
+    /**
+     * master seed of all random numbers. A given (seed, N, T, chainsPerTemp) gives the same measurements with
+     * simulate_seq and simulate_par, also in a Simulation with only this temperature. Initialized non-deterministic.
+     */
+    std::uint64_t seed;
+    /**
+     * algorithm of all runs, Wolff by default
+     */
+    Algorithm algorithm;
+    /**
+     * order of the Metropolis and heat-bath sweeps of every lattice, RowMajor by default. Checkerboard updates the
+     * lattice with the vectorized kernels of SweepKernels.h (AVX2/AVX-512 if available), its measurements are as
+     * valid as the ones of RowMajor but not the same. Not used by Wolff and Swendsen-Wang.
+     */
+    SweepOrder sweepOrder;
+    /**
+     * threads which work on every lattice at the same time (SpinLattice2level::threads), 1 by default. Used by the
+     * checkerboard sweeps and Swendsen-Wang, the measurements don't depend on it. Meant for a few large lattices:
+     * simulate_par and simulateAll run up to one lattice per core of the pool, each with these threads on top.
+     */
+    unsigned int threadsPerLattice;
+    /**
+     * lattice of simulate_seq, simulate_par and simulateAll, Standard by default. Packed stores 64 spins per word and
+     * sweeps them with bitwise operations, for large lattices with Metropolis or heat-bath. It always uses the
+     * checkerboard and one thread per lattice, sweepOrder and threadsPerLattice don't apply. simulate_pt always uses
+     * SpinLattice2level.
+     */
+    LatticeType latticeType;
+    /**
+     * iterations between two swap attempts of simulate_pt, 1 by default
+     */
+    unsigned int swapInterval;
+    /**
+     * independent chains per temperature of simulate_seq and simulate_par, 1 by default. The numIterations of a
+     * temperature are the total budget, they are split evenly into the chains. Use more chains than temperatures to
+     * keep all threads busy with only a few temperatures.
+     */
+    unsigned int chainsPerTemp;
+    /**
+     * simulateAll starts the tasks of simulations with a higher priority first, 0 by default
+     */
+    int priority;
+    /**
+     * time between two status prints while the simulation runs, 20 seconds by default
+     */
+    std::chrono::milliseconds statusInterval;
+    /**
+     * if set, the measurements are streamed to this writer while the simulation runs and the measurements
+     * (getEnergies, getBondSums, ...) stay empty. nullptr by default: the measurements are kept in memory.
+     */
+    MeasurementWriter *writer;
+    /**
+     * keep the measurements of a run without writer in memory, true by default. If only getSummary is needed, set to
+     * false and the memory of the measurements is saved.
+     */
+    bool keepMeasurements;
+    /**
+     * collect the joint histogram of bond and spin sums of every temperature while running (getHistograms), false by
+     * default. Its size only depends on N, so long runs can be reweighted without keeping or writing the measurements.
+     */
+    bool collectHistograms;
 private:
     /// Parameters for simulation
     unsigned int sights;
@@ -248,11 +843,24 @@ private:
     std::vector<float> temps;
     std::vector<float> energies;
     std::vector<float> magnetization;
-
-    /// Monitoring simulation parameters for std::cout
-    unsigned long tempIndexATM;
-    unsigned int amountOfThreads;
-    unsigned int amountOfWorkingThreads;
+    std::vector<long long> bondSums;
+    std::vector<long long> spinSums;
+    std::vector<unsigned int> chains;
+    // moments of every chain of every temperature, chain c of temperature t at t * chains + c
+    std::vector<ObservableMoments> chainMoments;
+    // histograms of every chain of every temperature like chainMoments, empty without collectHistograms
+    std::vector<JointHistogram> chainHistograms;
+    // blocks of the temperatures at the writer
+    std::vector<unsigned int> writerBlocks;
+    // swaps of the temperatures t and t+1 in simulate_pt
+    std::vector<unsigned long> swapAttempts;
+    std::vector<unsigned long> swapAccepts;
+
+    /// Monitoring simulation parameters for std::cout, written by the workers
+    // finished iterations of all temperatures
+    CopyableAtomic<unsigned long> tempIndexATM;
+    CopyableAtomic<unsigned int> amountOfThreads;
+    CopyableAtomic<unsigned int> amountOfWorkingThreads;
 
 public:
     bool printStat;
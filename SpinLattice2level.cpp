@@ -2,23 +2,27 @@
 // Created by chris on 14.06.21.
 //
 #include "SpinLattice2level.h"
+#include "Strips.h"
+#include "SweepKernels.h"
+
+#include <numeric>
 
 
 SpinLattice2level::SpinLattice2level(unsigned int sights)
-        : J(1), performedSweeps(0), mt(rd()), u_int_dist(0, 1), u_float_dist(0, 1), sights(sights),
-          spins(sights * sights), h(0) {
+        : J(1), performedSweeps(0), sweepOrder(SweepOrder::RowMajor), threads(1),
+          rng(randomSeed()), sights(sights), spins(sights * sights), h(0), bondSum(0), spinSum(0) {
     initRandom();
 }
 
 SpinLattice2level::SpinLattice2level(unsigned int sights, short h)
-        : J(1), performedSweeps(0), mt(rd()), u_int_dist(0, 1), u_float_dist(0, 1), sights(sights),
-          spins(sights * sights), h(h) {
+        : J(1), performedSweeps(0), sweepOrder(SweepOrder::RowMajor), threads(1),
+          rng(randomSeed()), sights(sights), spins(sights * sights), h(h), bondSum(0), spinSum(0) {
     initRandom();
 }
 
 SpinLattice2level::SpinLattice2level(const SpinLattice2level &sl)
-        : J(sl.J), performedSweeps(sl.performedSweeps), mt(rd()), u_int_dist(0, 1), u_float_dist(0, 1),
-          sights(sl.sights), h(sl.h) {
+        : J(sl.J), performedSweeps(sl.performedSweeps), sweepOrder(sl.sweepOrder), threads(sl.threads),
+          rng(randomSeed()), sights(sl.sights), h(sl.h), bondSum(sl.bondSum), spinSum(sl.spinSum) {
     spins = sl.spins;
 }
 
@@ -34,62 +38,126 @@ void SpinLattice2level::printSpins() const {
     std::cout << std::endl;
 }
 
+/**
+ * @return number of blocks of rowsPerStream rows, the last one may be smaller
+ */
+static inline unsigned int numOfBlocks(const SpinLattice2level &sl) {
+    return (sl.getSights() + SpinLattice2level::rowsPerStream - 1) / SpinLattice2level::rowsPerStream;
+}
+
+/**
+ * number of strips for the threads of a lattice, every strip consists of whole blocks
+ */
+static inline unsigned int blockStrips(const SpinLattice2level &sl) {
+    return std::clamp(sl.threads, 1u, numOfBlocks(sl));
+}
+
+/**
+ * @return first row of a strip of blockStrips
+ */
+static inline unsigned int blockStripBegin(const SpinLattice2level &sl, unsigned int strip, unsigned int strips) {
+    return std::min(stripBegin(strip, strips, numOfBlocks(sl)) * SpinLattice2level::rowsPerStream, sl.getSights());
+}
+
 void SpinLattice2level::initRandom() {
-    for (auto &s : spins) {
-        s = u_int_dist(mt) == 0 ? -1 : 1;
-    }
+    const std::uint64_t initSeed = rng();
+    const unsigned int strips = blockStrips(*this);
+    workers.run(strips, [this, initSeed, strips](unsigned int strip, auto &) {
+        const size_t begin = static_cast<size_t>(blockStripBegin(*this, strip, strips)) * sights;
+        const size_t end = static_cast<size_t>(blockStripBegin(*this, strip + 1, strips)) * sights;
+        const size_t blockSize = static_cast<size_t>(rowsPerStream) * sights;
+        Rng blockRng;
+        // one random word gives 64 spins
+        std::uint64_t bits = 0;
+        for (size_t i = begin; i < end; ++i) {
+            if ((i - begin) % blockSize == 0) {
+                blockRng.seed(deriveSeed(initSeed, {i / blockSize}));
+            }
+            if ((i - begin) % blockSize % 64 == 0) {
+                bits = blockRng();
+            }
+            spins[i] = (bits >> ((i - begin) % blockSize % 64) & 1u) ? 1 : -1;
+        }
+    });
+    recalcTotals();
 }
 
 void SpinLattice2level::initCold() {
     std::fill(spins.begin(), spins.end(), -1);
+    recalcTotals();
+}
+
+void SpinLattice2level::seed(std::uint64_t seed) {
+    rng.seed(seed);
+}
+
+void SpinLattice2level::recalcTotals() {
+    const auto [bonds, sum] = countTotals();
+    bondSum = bonds;
+    spinSum = sum;
+}
+
+std::pair<long long, long long> SpinLattice2level::countTotals() const {
+    const unsigned int strips = std::clamp(threads, 1u, sights);
+    std::vector<long long> bonds(strips), sums(strips);
+    workers.run(strips, [this, strips, &bonds, &sums](unsigned int strip, auto &) {
+        // every bond is counted once via the right and the lower neighbour
+        long long stripBonds = 0;
+        long long stripSum = 0;
+        for (unsigned int y = stripBegin(strip, strips, sights); y < stripBegin(strip + 1, strips, sights); ++y) {
+            const short *row = &spins[static_cast<size_t>(y) * sights];
+            const short *down = &spins[static_cast<size_t>((y + 1) % sights) * sights];
+            for (unsigned int x = 0; x < sights; ++x) {
+                const short right = x + 1 == sights ? row[0] : row[x + 1];
+                stripBonds += row[x] * (right + down[x]);
+                stripSum += row[x];
+            }
+        }
+        bonds[strip] = stripBonds;
+        sums[strip] = stripSum;
+    });
+    return {std::accumulate(bonds.begin(), bonds.end(), 0LL), std::accumulate(sums.begin(), sums.end(), 0LL)};
 }
 
-inline int SpinLattice2level::calcEnergy(const SpinLattice2level::Loc2d &loc, int newSpinVal) const {
 #ifdef DEBUG
-    if(1!=std::abs(newSpin)){
-        std::cerr<<"this is no valid spin ("<<newSpin<<")\n";
-        exit(12);
+void SpinLattice2level::checkTotals() const {
+    const auto [bonds, sum] = countTotals();
+    if (bonds != bondSum || sum != spinSum) {
+        std::cerr << "running totals (bonds " << bondSum << ", spins " << spinSum << ") differ from the lattice (bonds "
+                  << bonds << ", spins " << sum << ")\n";
+        exit(14);
     }
+}
 #endif
-    const auto neighbours = getNeighbours(loc);
-    int energy = 0;
 
-    for (const auto &n:neighbours) {
-        energy += operator()(n);
+inline int SpinLattice2level::calcEnergy(const SpinLattice2level::Loc2d &loc, int newSpinVal) const {
+#ifdef DEBUG
+    if(1!=std::abs(newSpinVal)){
+        std::cerr<<"this is no valid spin ("<<newSpinVal<<")\n";
+        exit(12);
     }
-    energy = -1 * J * energy * newSpinVal;
-    return energy;
-
+#endif
+    return -1 * J * sumOfNeighbours(loc) * newSpinVal;
 }
 
 float SpinLattice2level::calcEnergy() const {
-    int energyIt = 0;
-    for (size_t i = 0; i < sights; ++i) {
-        for (size_t j = 0; j < sights; ++j) {
-            energyIt += calcEnergy(SpinLattice2level::Loc2d(i, j));
-        }
-    }
-    float energy = static_cast<float>(energyIt) / static_cast<float>(2 * 4 * sights * sights) + 0.5f;//scale to [0,1]
-    return energy;
+#ifdef DEBUG
+    checkTotals();
+#endif
+    return normalizedEnergy(bondSum, J, sights);
 }
 
 
 float SpinLattice2level::calcMagnetization() const {
-    float magnet = 0;
-    for (const auto &s : spins) {
-        magnet += static_cast<float>(s);
 #ifdef DEBUG
-        if (std::abs(magnet) > static_cast<float>(spins.size())) {
-            std::cerr << "magnetization is " << magnet << " this is higher than possible\n";
-            printSpins();
-            exit(13);
-        }
-#endif
+    checkTotals();
+    if (std::abs(spinSum) > static_cast<long long>(spins.size())) {
+        std::cerr << "magnetization is " << spinSum << " this is higher than possible\n";
+        printSpins();
+        exit(13);
     }
-#ifdef DEBUG
-    std::cout << magnet << std::endl;
 #endif
-    return magnet / static_cast<float>(spins.size());
+    return normalizedMagnetization(spinSum, sights);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -97,127 +165,231 @@ float SpinLattice2level::calcMagnetization() const {
 ////////////////////////////////////////////////////////////////////////////////
 
 
+BoltzmannTable::BoltzmannTable(const SpinLattice2level &sl, float temp) : metropolis(), heatBath() {
+    for (int sum = -4; sum <= 4; sum += 2) {
+        const int field = sl.J * sum + sl.getH();
+        for (short s : {-1, 1}) {
+            const int deltaE = 2 * s * field;
+            metropolis[index(s, sum)] = deltaE < 0 ? 1.0f : std::exp(static_cast<float>(-1 * deltaE) / temp);
+        }
+        const float k = static_cast<float>(-1 * field) / temp;
+        heatBath[sumIndex(sum)] = std::exp(-1.0f * k) / 2.0f / std::cosh(k);
+    }
+}
+
+/**
+ * visits every site once in row-major order, the checkerboard is handled by the row kernels
+ * @param update function which is called with the location of every site
+ */
+template<typename Update>
+static inline void visitSites(const SpinLattice2level &spinLattice, Update update) {
+    const unsigned int sights = spinLattice.getSights();
+    for (unsigned int i = 0; i < sights; ++i) {
+        for (unsigned int j = 0; j < sights; ++j) {
+            update(SpinLattice2level::Loc2d(i, j));
+        }
+    }
+}
+
+/**
+ * quantizes a probability to a threshold for uniformly distributed 32-bit random numbers
+ */
+static inline std::uint32_t probabilityThreshold(double p) {
+    return static_cast<std::uint32_t>(std::clamp(p * 4294967296.0, 0.0, 4294967295.0));
+}
+
+/**
+ * Sweeps the checkerboard with the vectorized row kernels, see SweepKernels.h.
+ * The random numbers of a row are drawn in advance, one per updated site, from the stream of its block of rows.
+ * The kernels return the changes of the running totals.
+ *
+ * With more threads every thread updates a strip of blocks, a barrier separates the half-sweeps. The first and the
+ * last row of a strip are updated with the scalar kernel (borderKernel), which touches only the updated sites, so the
+ * threads never access the same site at the same time. For an odd number of sights the first and the last row of the
+ * lattice contain neighbours of the same colour, so only one strip is used.
+ */
+static void checkerboardKernelSweep(SpinLattice2level &spinLattice, RowKernel kernel, RowKernel borderKernel,
+                                    const std::array<std::uint32_t, 16> &table, unsigned int sweeps) {
+    const unsigned int sights = spinLattice.getSights();
+    const unsigned int strips = sights % 2 == 0 ? blockStrips(spinLattice) : 1;
+    std::vector<std::uint64_t> sweepSeeds(sweeps);
+    for (auto &s : sweepSeeds) {
+        s = spinLattice.rng();
+    }
+    std::vector<long long> spinDeltas(strips), bondDeltas(strips);
+    auto &buffers = spinLattice.stripRandom;
+    if (buffers.size() < strips) {
+        buffers.resize(strips);
+    }
+    for (unsigned int strip = 0; strip < strips; ++strip) {
+        buffers[strip].resize((sights + 1) / 2);
+    }
+
+    spinLattice.workers.run(strips, [&](unsigned int strip, auto &sync) {
+        const unsigned int begin = blockStripBegin(spinLattice, strip, strips);
+        const unsigned int end = blockStripBegin(spinLattice, strip + 1, strips);
+        std::vector<std::uint32_t> &random = buffers[strip];
+        Xoshiro256ssBatch<8> blockRng;
+        long long spinDelta = 0;
+        long long bondDelta = 0;
+        for (unsigned int sweep = 0; sweep < sweeps; ++sweep) {
+            for (unsigned int colour = 0; colour < 2; ++colour) {
+                for (unsigned int y = begin; y < end; ++y) {
+                    if (y % SpinLattice2level::rowsPerStream == 0) {
+                        blockRng.seedSplitMix(deriveSeed(sweepSeeds[sweep], {colour, y}));
+                    }
+                    const unsigned int firstX = (y + colour) % 2;
+                    const unsigned int sites = (sights - firstX + 1) / 2;
+                    blockRng.fill(random.data(), sites);
+                    const bool border = strips > 1 && (y == begin || y + 1 == end);
+                    const RowDelta delta = (border ? borderKernel : kernel)(
+                            RowKernelArgs{&spinLattice(0, y), &spinLattice(0, (y + sights - 1) % sights),
+                                          &spinLattice(0, (y + 1) % sights), random.data(), table.data(), sights,
+                                          firstX});
+                    spinDelta += delta.spinSum;
+                    bondDelta += delta.bondSum;
+                }
+                sync.arrive_and_wait();
+            }
+        }
+        spinDeltas[strip] = spinDelta;
+        bondDeltas[strip] = bondDelta;
+    });
+
+    spinLattice.updateTotals(std::accumulate(spinDeltas.begin(), spinDeltas.end(), 0LL),
+                             std::accumulate(bondDeltas.begin(), bondDeltas.end(), 0LL));
+    spinLattice.performedSweeps += sweeps;
+}
+
+/**
+ * thresholds of metropolisRowKernel: a flip of s is proposed with probability 1/2 (new random spin) and accepted with
+ * min(1, exp(-deltaE/T))
+ */
+static std::array<std::uint32_t, 16> metropolisKernelTable(const SpinLattice2level &spinLattice, float temp) {
+    std::array<std::uint32_t, 16> table{};
+    for (int index = 0; index < 5; ++index) {
+        const int field = spinLattice.J * (2 * index - 4) + spinLattice.getH();
+        for (int s : {-1, 1}) {
+            const int deltaE = 2 * s * field;
+            table[(s > 0 ? 8 : 0) + index] = probabilityThreshold(0.5 * std::min(1.0, std::exp(-1.0 * deltaE / temp)));
+        }
+    }
+    return table;
+}
+
+/**
+ * thresholds of heatBathRowKernel: probability of spin 1 by the sum of the neighbours 2 * index - 4
+ */
+static std::array<std::uint32_t, 16> heatBathKernelTable(const SpinLattice2level &spinLattice, float temp) {
+    std::array<std::uint32_t, 16> table{};
+    for (int index = 0; index < 5; ++index) {
+        const double k = static_cast<double>(spinLattice.J * (2 * index - 4) + spinLattice.getH()) / temp;
+        table[index] = probabilityThreshold(1.0 / (1.0 + std::exp(-2.0 * k)));
+    }
+    return table;
+}
+
 void metropolisSweep(SpinLattice2level &spinLattice, const float &temp) {
-    for (size_t i = 0; i < spinLattice.getSights(); ++i) {
-        for (size_t j = 0; j < spinLattice.getSights(); ++j) {
-            const short newSpin = spinLattice.u_int_dist(spinLattice.mt) == 0 ? -1 : 1;
+    if (spinLattice.sweepOrder == SweepOrder::Checkerboard) {
+        checkerboardKernelSweep(spinLattice, metropolisRowKernel(), metropolisRowKernel(KernelIsa::Scalar),
+                                metropolisKernelTable(spinLattice, temp), 1);
+        return;
+    }
+    const BoltzmannTable table(spinLattice, temp);
+    visitSites(spinLattice, [&spinLattice, &table](const SpinLattice2level::Loc2d &loc) {
+        const short newSpin = spinLattice.rng.bit() == 0 ? -1 : 1;
 #ifdef DEBUG
-            if (std::abs(newSpin))!=1){
-                std::cerr << "new calculated Spin " << newSpin << " is not valid\n";
-                exit(15);
-            }
+        if (std::abs(newSpin) != 1) {
+            std::cerr << "new calculated Spin " << newSpin << " is not valid\n";
+            exit(15);
+        }
 #endif
-            if (newSpin == spinLattice(i, j)) {// spin has not changed, so skip all the work
+        if (newSpin == spinLattice(loc)) {// spin has not changed, so skip all the work
+        } else {
+            const int sum = spinLattice.sumOfNeighbours(loc);
+            const float acceptance = table.metropolis[BoltzmannTable::index(spinLattice(loc), sum)];
+            if (acceptance >= 1.0f) {// energy doesn't increase, so accept
+                spinLattice.flipSpin(loc, sum);
             } else {
-                const auto loc = SpinLattice2level::Loc2d(i, j);
-                const int newEnergy = spinLattice.calcEnergy(loc, newSpin);
-                const int deltaE = 2 * newEnergy; //if spin flips, energy changes from either -4 to 4 or -2 to 2
-
-                if (deltaE < 0) {// energy decreases, so accept
-                    spinLattice(loc) *= -1;
-                } else {
-                    const float rand = spinLattice.u_float_dist(spinLattice.mt);
-                    if (rand < std::exp(static_cast<float>(-1 * deltaE) / temp)) {
-                        spinLattice(loc) *= -1;
-                    }
+                const float rand = spinLattice.rng.uniformFloat();
+                if (rand < acceptance) {
+                    spinLattice.flipSpin(loc, sum);
                 }
             }
         }
-    }
+    });
     spinLattice.performedSweeps++;
 }
 
 void metropolisSweep(SpinLattice2level &spinLattice, const float &temp, const unsigned int &iterations) {
+    if (spinLattice.sweepOrder == SweepOrder::Checkerboard) {
+        // the threads are started once for all iterations
+        checkerboardKernelSweep(spinLattice, metropolisRowKernel(), metropolisRowKernel(KernelIsa::Scalar),
+                                metropolisKernelTable(spinLattice, temp), iterations);
+        return;
+    }
     for (size_t i = 0; i < iterations; ++i) {
         metropolisSweep(spinLattice, temp);
     }
 }
 
-inline int heatBathSumOfNeighbours(const SpinLattice2level &sl, const SpinLattice2level::Loc2d &loc) {
-    int sum = 0;
-    auto neighbours = sl.getNeighbours(loc);
-    for (const auto &n:neighbours) {
-        sum += sl(n);
-    }
-    return sum;
-}
-
 void heatBathSweep(SpinLattice2level &spinLattice, const float &temp) {
-    const auto J_val = spinLattice.J;
-    auto mt = std::mt19937(spinLattice.rd());
-    for (size_t i = 0; i < spinLattice.getSights(); i += 1) {
-        for (size_t j = 0; j < spinLattice.getSights(); j += 1) {
-            const auto loc = SpinLattice2level::Loc2d(i, j);
-
-            const int delta = heatBathSumOfNeighbours(spinLattice, loc);
-            const float k = static_cast<float>(-1 * J_val * delta) / temp;
-            const float q = std::exp(-1.0f * k) / 2.0f / std::cosh(k);
-            const float r = spinLattice.u_float_dist(mt);
-            if (r < q) {
-                spinLattice(loc) = 1;
-            } else {
-                spinLattice(loc) = -1;
-            }
-        }
+    if (spinLattice.sweepOrder == SweepOrder::Checkerboard) {
+        checkerboardKernelSweep(spinLattice, heatBathRowKernel(), heatBathRowKernel(KernelIsa::Scalar),
+                                heatBathKernelTable(spinLattice, temp), 1);
+        return;
     }
+    const BoltzmannTable table(spinLattice, temp);
+    visitSites(spinLattice, [&spinLattice, &table](const SpinLattice2level::Loc2d &loc) {
+        const int sum = spinLattice.sumOfNeighbours(loc);
+        const float q = table.heatBath[BoltzmannTable::sumIndex(sum)];
+        const float r = spinLattice.rng.uniformFloat();
+        if (r < q) {
+            spinLattice.setSpin(loc, 1, sum);
+        } else {
+            spinLattice.setSpin(loc, -1, sum);
+        }
+    });
     spinLattice.performedSweeps++;
 }
 
 void heatBathSweep(SpinLattice2level &spinLattice, const float &temp, const unsigned int &iterations) {
+    if (spinLattice.sweepOrder == SweepOrder::Checkerboard) {
+        checkerboardKernelSweep(spinLattice, heatBathRowKernel(), heatBathRowKernel(KernelIsa::Scalar),
+                                heatBathKernelTable(spinLattice, temp), iterations);
+        return;
+    }
     for (size_t i = 0; i < iterations; ++i) {
         heatBathSweep(spinLattice, temp);
     }
 }
 
 void heatBathSweepRandChoice(SpinLattice2level &spinLattice, const float &temp) {
-    const auto J_val = spinLattice.J;
-    static std::uniform_int_distribution<unsigned int> u(0, spinLattice.getSights() - 1);
+    const BoltzmannTable table(spinLattice, temp);
+    const unsigned int sights = spinLattice.getSights();
 
-    for (size_t i = 0; i < spinLattice.getSights() * spinLattice.getSights(); i++) {
-        const unsigned int x = u(spinLattice.mt);
-        const unsigned int y = u(spinLattice.mt);
+    for (size_t i = 0; i < sights * sights; i++) {
+        const unsigned int x = spinLattice.rng.bounded(sights);
+        const unsigned int y = spinLattice.rng.bounded(sights);
 
         const auto loc = SpinLattice2level::Loc2d(x, y);
 
-        const int delta = heatBathSumOfNeighbours(spinLattice, loc);
-        const float k = static_cast<float>(-1 * J_val * delta) / temp;
-        const float q = std::exp(-1.0f * k) / 2.0f / std::cosh(k);
-        const float r = spinLattice.u_float_dist(spinLattice.mt);
+        const int sum = spinLattice.sumOfNeighbours(loc);
+        const float q = table.heatBath[BoltzmannTable::sumIndex(sum)];
+        const float r = spinLattice.rng.uniformFloat();
         if (r < q) {
-            spinLattice(loc) = 1;
+            spinLattice.setSpin(loc, 1, sum);
         } else {
-            spinLattice(loc) = -1;
+            spinLattice.setSpin(loc, -1, sum);
         }
     }
     spinLattice.performedSweeps++;
 }
 
 void wolffSweep(SpinLattice2level &sl, const float &temp) {
-    std::uniform_int_distribution<unsigned int> u(0, sl.getSights() - 1);
-
-    // queue to save all locations of cluster
-    // initialize with random location
-    const SpinLattice2level::Loc2d startLoc{u(sl.mt), u(sl.mt)};
-    sl(startLoc) *= -1;
-    std::deque<SpinLattice2level::Loc2d> queue{startLoc};
-
-    while (!queue.empty()) {
-        // process first loc
-        auto loc = queue.front();
-        queue.pop_front();
-
-        // calculate neighbours locations
-        auto neighbours = sl.getNeighbours(loc);
-
-        std::uniform_real_distribution<float> r(0, 1);
-        for (auto n:neighbours) {
-            if (sl(loc) * -1 == sl(n) &&
-                1 - std::exp(-2.0f * static_cast<float>(sl.J) / temp) > r(sl.mt)) {
-                sl(n) *= -1;
-                queue.push_back(n);
-            }
-        }
-    }
+    // the only probability of the cluster algorithm, calculated once instead of for every neighbour
+    const float bondProbability = 1 - std::exp(-2.0f * static_cast<float>(sl.J) / temp);
+    sl.wolff.flipCluster(sl, bondProbability);
     sl.performedSweeps++;
 }
 
@@ -226,3 +398,15 @@ void wolffSweep(SpinLattice2level &spinLattice, const float &temp, const unsigne
         wolffSweep(spinLattice, temp);
     }
 }
+
+void swendsenWangSweep(SpinLattice2level &spinLattice, const float &temp) {
+    const float bondProbability = 1 - std::exp(-2.0f * static_cast<float>(spinLattice.J) / temp);
+    spinLattice.swendsenWang.sweep(spinLattice, bondProbability, spinLattice.threads);
+    spinLattice.performedSweeps++;
+}
+
+void swendsenWangSweep(SpinLattice2level &spinLattice, const float &temp, const unsigned int &iterations) {
+    for (unsigned int i = 0; i < iterations; ++i) {
+        swendsenWangSweep(spinLattice, temp);
+    }
+}
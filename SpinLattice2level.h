@@ -6,11 +6,27 @@
 #include <algorithm>
 #include <array>
 #include <cassert>
-#include <deque>
+#include <cstdint>
 #include <iostream>
 #include <random>
 #include <vector>
 
+#include "Rng.h"
+#include "Strips.h"
+#include "SwendsenWangEngine.h"
+#include "WolffEngine.h"
+
+/**
+ * order in which metropolisSweep and heatBathSweep visit the sites
+ */
+enum class SweepOrder {
+    // site after site along the lattice, like all results before the checkerboard was introduced
+    RowMajor,
+    // first all sites with even x+y, then all sites with odd x+y. The sites of one half-sweep don't depend on each
+    // other (for an even number of sights), so they are updated with the vectorized kernels of SweepKernels.h.
+    Checkerboard
+};
+
 // a quadratic 2-level ising-lattice
 class SpinLattice2level {
 public:
@@ -45,6 +61,9 @@ public:
     // Reinitialize all spins with -1
     void initCold();
 
+    // Restart the random number generator with a given seed
+    void seed(std::uint64_t seed);
+
 
     inline short operator()(unsigned int x, unsigned int y) const {
 #ifdef DEBUG
@@ -53,6 +72,10 @@ public:
         return spins[x + y * sights];
     }
 
+    /**
+     * direct access to a spin: the running totals of calcEnergy and calcMagnetization are not updated, so use setSpin
+     * or call recalcTotals after writing
+     */
     inline short &operator()(unsigned int x, unsigned int y) {
 #ifdef DEBUG
         assert(x < sights && y < sights);
@@ -88,11 +111,62 @@ public:
         std::array<SpinLattice2level::Loc2d, 4>
                 neighbours{SpinLattice2level::Loc2d((loc.first + 1) % sights, loc.second),
                            SpinLattice2level::Loc2d(loc.first, (loc.second + 1) % sights),
-                           SpinLattice2level::Loc2d((loc.first - 1) % sights, loc.second),
-                           SpinLattice2level::Loc2d(loc.first, (loc.second - 1) % sights)};
+                           SpinLattice2level::Loc2d((loc.first + sights - 1) % sights, loc.second),
+                           SpinLattice2level::Loc2d(loc.first, (loc.second + sights - 1) % sights)};
         return neighbours;
     }
 
+    /**
+     * @return sum of the four neighbours of loc, between -4 and 4
+     */
+    [[nodiscard]] inline int sumOfNeighbours(const SpinLattice2level::Loc2d &loc) const {
+        int sum = 0;
+        for (const auto &n : getNeighbours(loc)) {
+            sum += operator()(n);
+        }
+        return sum;
+    }
+
+    /**
+     * sets a spin and updates the running totals
+     * @param neighbourSum sumOfNeighbours(loc), if the caller already knows it
+     */
+    inline void setSpin(const SpinLattice2level::Loc2d &loc, short spin, int neighbourSum) {
+        short &s = operator()(loc);
+        const int delta = spin - s;
+        spinSum += delta;
+        bondSum += delta * neighbourSum;
+        s = spin;
+    }
+
+    inline void setSpin(const SpinLattice2level::Loc2d &loc, short spin) {
+        setSpin(loc, spin, sumOfNeighbours(loc));
+    }
+
+    inline void flipSpin(const SpinLattice2level::Loc2d &loc, int neighbourSum) {
+        setSpin(loc, static_cast<short>(-operator()(loc)), neighbourSum);
+    }
+
+    inline void flipSpin(const SpinLattice2level::Loc2d &loc) {
+        flipSpin(loc, sumOfNeighbours(loc));
+    }
+
+    /**
+     * adds changes of spins which were written directly (e.g. by the row kernels) to the running totals
+     * @param spinDelta change of the sum of all spins
+     * @param bondDelta change of the sum over all bonds
+     */
+    inline void updateTotals(long long spinDelta, long long bondDelta) {
+        spinSum += spinDelta;
+        bondSum += bondDelta;
+    }
+
+    /**
+     * recalculates the running totals from all spins, needed after writing spins with operator()
+     * complexity: O(N^2 / threads)
+     */
+    void recalcTotals();
+
     [[nodiscard]] int calcEnergy(const SpinLattice2level::Loc2d &loc, int newSpinVal) const;
 
     [[nodiscard]] inline int calcEnergy(const SpinLattice2level::Loc2d &loc) const {
@@ -101,18 +175,55 @@ public:
 
     /**
      * calculates normalized energy of system: sum over all spins, divided by 4N²
-     * complexity: O(N^2)
-     * TODO there maybe are algorithms which can do this in n log n: search for matrix convolution
+     * complexity: O(1), all algorithms keep the sum over all bonds up to date
      * @return energy between 0 and 1
     */
     [[nodiscard]] float calcEnergy() const;
 
     /**
      *calculates normalized magnetization: sum over all spins, divided by N²
+     * complexity: O(1)
      * @return magnetization between -1 and 1
      */
     [[nodiscard]] float calcMagnetization() const;
 
+    /**
+     * @return calcEnergy of a lattice with the given bond sum, e.g. for stored measurements
+     */
+    [[nodiscard]] static inline float normalizedEnergy(long long bondSum, int J, unsigned int sights) {
+        // the sum over all sites counts every bond twice
+        const long long energyIt = -2 * J * bondSum;
+        return static_cast<float>(energyIt) / static_cast<float>(2 * 4 * sights * sights) + 0.5f;//scale to [0,1]
+    }
+
+    /**
+     * @return calcMagnetization of a lattice with the given spin sum
+     */
+    [[nodiscard]] static inline float normalizedMagnetization(long long spinSum, unsigned int sights) {
+        return static_cast<float>(spinSum) / static_cast<float>(static_cast<size_t>(sights) * sights);
+    }
+
+    /**
+     * @return sum of s_i * s_j over all bonds, every bond counted once
+     */
+    [[nodiscard]] inline long long getBondSum() const {
+        return bondSum;
+    }
+
+    /**
+     * @return sum over all spins
+     */
+    [[nodiscard]] inline long long getSpinSum() const {
+        return spinSum;
+    }
+
+    /**
+     * @return energy -J * bondSum - h * spinSum of the lattice, not normalized, e.g. for replica exchange
+     */
+    [[nodiscard]] inline long long getTotalEnergy() const {
+        return -1LL * J * bondSum - 1LL * h * spinSum;
+    }
+
 
     [[nodiscard]] inline unsigned int getSights() const {
         return sights;
@@ -122,24 +233,99 @@ public:
         return spins;
     }
 
+    [[nodiscard]] inline int getH() const {
+        return h;
+    }
+
     int J;
 
     unsigned int performedSweeps;
 
-    std::random_device rd;
-    std::mt19937 mt;
     /**
-     * returns int either 0 or 1
+     * order of the local algorithms metropolisSweep and heatBathSweep, RowMajor by default
+     */
+    SweepOrder sweepOrder;
+
+    /**
+     * number of threads which work on this lattice at the same time, 1 by default. The lattice is split into strips of
+     * rows (see Strips.h) for the checkerboard order of metropolisSweep and heatBathSweep, swendsenWangSweep,
+     * initRandom and recalcTotals. The results don't depend on the number of threads.
+     */
+    unsigned int threads;
+
+    /**
+     * The random numbers of the checkerboard sweeps and initRandom are drawn from one stream per block of rows, the
+     * strips of the threads consist of whole blocks.
+     */
+    static constexpr unsigned int rowsPerStream = 16;
+
+    /**
+     * generator of all algorithms, replace the typedef to plug in another UniformRandomBitGenerator with the
+     * interface of Xoshiro256ss
+     */
+    typedef Xoshiro256ss Rng;
+    Rng rng;
+    /**
+     * buffers of wolffSweep, allocated once per lattice
+     */
+    WolffEngine wolff;
+    /**
+     * buffers of swendsenWangSweep, allocated once per lattice
+     */
+    SwendsenWangEngine swendsenWang;
+    /**
+     * threads of the strips, started with the first sweep with more than one strip and kept for the next sweeps
      */
-    std::uniform_int_distribution<short> u_int_dist;
+    mutable StripWorkers workers;
     /**
-     * returns a float between 0 and 1
+     * random numbers of one row per strip for the checkerboard sweeps, allocated once per lattice
      */
-    std::uniform_real_distribution<float> u_float_dist;
+    std::vector<std::vector<std::uint32_t>> stripRandom;
 private:
+    // sum over all bonds and all spins by a full pass over the lattice
+    [[nodiscard]] std::pair<long long, long long> countTotals() const;
+
+#ifdef DEBUG
+    // compares the running totals with countTotals
+    void checkTotals() const;
+#endif
+
     unsigned int sights;
     std::vector<short> spins;
     int h;
+    // running totals, updated with every changed spin
+    long long bondSum;
+    long long spinSum;
+};
+
+/**
+ * Probabilities of the Markov algorithms at one temperature. With four neighbours the local field only takes five
+ * values, so they are calculated once per sweep and the loops over the sites need no exp or cosh.
+ * J and the extern field h are included: a spin s with the sum of neighbours n has the energy -s * (J * n + h).
+ */
+struct BoltzmannTable {
+    BoltzmannTable(const SpinLattice2level &sl, float temp);
+
+    /**
+     * @param sum sum of the four neighbours
+     * @return index of metropolis for a spin s with the given sum of neighbours
+     */
+    static inline unsigned int index(short s, int sum) {
+        return (s > 0 ? 5 : 0) + sumIndex(sum);
+    }
+
+    /**
+     * @param sum sum of the four neighbours
+     * @return index of heatBath for the given sum of neighbours
+     */
+    static inline unsigned int sumIndex(int sum) {
+        return static_cast<unsigned int>(sum + 4) / 2;
+    }
+
+    // probability min(1, exp(-deltaE/T)) to accept flipping a spin, see index()
+    std::array<float, 10> metropolis;
+    // probability of spin 1 for a sum of neighbours, see sumIndex()
+    std::array<float, 5> heatBath;
 };
 
 void metropolisSweep(SpinLattice2level &spinLattice, const float &temp);
@@ -154,4 +340,12 @@ void heatBathSweepRandChoice(SpinLattice2level &spinLattice, const float &temp);
 
 void wolffSweep(SpinLattice2level &sl, const float &temp);
 
-void wolffSweep(SpinLattice2level &spinLattice, const float &temp, const unsigned int &iterations);
\ No newline at end of file
+void wolffSweep(SpinLattice2level &spinLattice, const float &temp, const unsigned int &iterations);
+
+/**
+ * Swendsen-Wang: flips all clusters of the lattice with probability 1/2, see SwendsenWangEngine.
+ * Uses spinLattice.threads threads.
+ */
+void swendsenWangSweep(SpinLattice2level &spinLattice, const float &temp);
+
+void swendsenWangSweep(SpinLattice2level &spinLattice, const float &temp, const unsigned int &iterations);
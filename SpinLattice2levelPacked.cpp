@@ -0,0 +1,257 @@
+//
+// Created by chris on 17.10.26.
+//
+#include "SpinLattice2levelPacked.h"
+
+#include <bit>
+#include <cmath>
+
+SpinLattice2levelPacked::SpinLattice2levelPacked(unsigned int sights)
+        : J(1), performedSweeps(0), rng(randomSeed()), sights(sights), wordsPerRow(sights / 64),
+          words(static_cast<size_t>(sights / 64) * sights) {
+    if (sights == 0 || sights % 64 != 0) {
+        std::cerr << "packed lattice needs a multiple of 64 sights, got " << sights << "\n";
+        exit(16);
+    }
+    initRandom();
+}
+
+SpinLattice2levelPacked::SpinLattice2levelPacked(const SpinLattice2level &sl)
+        : SpinLattice2levelPacked(sl.getSights()) {
+    if (sl.getH() != 0) {
+        std::cerr << "packed lattice has no extern magnetic field, got h=" << sl.getH() << "\n";
+        exit(16);
+    }
+    J = sl.J;
+    performedSweeps = sl.performedSweeps;
+    for (unsigned int y = 0; y < sights; ++y) {
+        for (unsigned int x = 0; x < sights; ++x) {
+            setSpin(x, y, sl(x, y));
+        }
+    }
+}
+
+SpinLattice2levelPacked::SpinLattice2levelPacked(const SpinLattice2levelPacked &sl)
+        : J(sl.J), performedSweeps(sl.performedSweeps), rng(randomSeed()), sights(sl.sights),
+          wordsPerRow(sl.wordsPerRow) {
+    words = sl.words;
+}
+
+void SpinLattice2levelPacked::printSpins() const {
+    for (unsigned int y = 0; y < sights; y++) {
+        for (unsigned int x = 0; x < sights; x++) {
+            std::cout << operator()(x, y);
+            if (x + 1 == sights) {//right boarder
+                std::cout << std::endl;
+            } else {
+                std::cout << "\t";
+            }
+        }
+    }
+    std::cout << std::endl;
+}
+
+void SpinLattice2levelPacked::initRandom() {
+    for (auto &w : words) {
+        w = rng();
+    }
+}
+
+void SpinLattice2levelPacked::seed(std::uint64_t seed) {
+    rng.seed(seed);
+}
+
+void SpinLattice2levelPacked::initCold() {
+    std::fill(words.begin(), words.end(), 0);
+}
+
+SpinLattice2level SpinLattice2levelPacked::unpack() const {
+    SpinLattice2level sl(sights);
+    sl.J = J;
+    sl.performedSweeps = performedSweeps;
+    for (unsigned int y = 0; y < sights; ++y) {
+        for (unsigned int x = 0; x < sights; ++x) {
+            sl(x, y) = operator()(x, y);
+        }
+    }
+    sl.recalcTotals();
+    return sl;
+}
+
+/**
+ * neighbour words in x-direction: at the row boundary the spins move to the next bit
+ */
+static inline SpinLattice2levelPacked::Word
+rightWord(const SpinLattice2levelPacked::Word *row, unsigned int k, unsigned int wordsPerRow) {
+    return k + 1 < wordsPerRow ? row[k + 1] : std::rotr(row[0], 1);
+}
+
+static inline SpinLattice2levelPacked::Word
+leftWord(const SpinLattice2levelPacked::Word *row, unsigned int k, unsigned int wordsPerRow) {
+    return k > 0 ? row[k - 1] : std::rotl(row[wordsPerRow - 1], 1);
+}
+
+long long SpinLattice2levelPacked::getBondSum() const {
+    // every bond is counted once via the right and the lower neighbour
+    long long antiParallel = 0;
+    for (unsigned int y = 0; y < sights; ++y) {
+        const Word *row = &words[static_cast<size_t>(y) * wordsPerRow];
+        const Word *down = &words[static_cast<size_t>((y + 1) % sights) * wordsPerRow];
+        for (unsigned int k = 0; k < wordsPerRow; ++k) {
+            antiParallel += std::popcount(row[k] ^ rightWord(row, k, wordsPerRow));
+            antiParallel += std::popcount(row[k] ^ down[k]);
+        }
+    }
+    return 2 * static_cast<long long>(sights) * sights - 2 * antiParallel;
+}
+
+long long SpinLattice2levelPacked::getSpinSum() const {
+    long long up = 0;
+    for (const auto &w : words) {
+        up += std::popcount(w);
+    }
+    return 2 * up - static_cast<long long>(sights) * sights;
+}
+
+float SpinLattice2levelPacked::calcEnergy() const {
+    // same normalization as SpinLattice2level::calcEnergy
+    return SpinLattice2level::normalizedEnergy(getBondSum(), J, sights);
+}
+
+float SpinLattice2levelPacked::calcMagnetization() const {
+    return SpinLattice2level::normalizedMagnetization(getSpinSum(), sights);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// Markov Algorithms (multi-spin coded)
+////////////////////////////////////////////////////////////////////////////////
+
+/// probabilities are quantized to 2^-bernoulliBits
+static constexpr unsigned int bernoulliBits = 24;
+static constexpr std::uint32_t bernoulliOne = 1u << bernoulliBits;
+
+static inline std::uint32_t quantizeProbability(double p) {
+    return static_cast<std::uint32_t>(std::clamp(std::lround(p * bernoulliOne), 0l, static_cast<long>(bernoulliOne)));
+}
+
+/**
+ * draws a word where every bit is set independently with probability p/2^bernoulliBits.
+ * The bits of p are processed from the least significant one: OR-ing with a random word adds 1/2, AND-ing halves.
+ */
+static inline SpinLattice2levelPacked::Word bernoulliWord(std::uint32_t p, SpinLattice2level::Rng &rng) {
+    if (p == 0) {
+        return 0;
+    }
+    if (p >= bernoulliOne) {
+        return ~SpinLattice2levelPacked::Word(0);
+    }
+    unsigned int i = std::countr_zero(p);
+    SpinLattice2levelPacked::Word mask = rng();
+    for (++i; i < bernoulliBits; ++i) {
+        mask = (p >> i & 1u) ? (mask | rng()) : (mask & rng());
+    }
+    return mask;
+}
+
+/**
+ * bit sliced count of the set bits in four words
+ * @return bits of the count (0 to 4) as {ones, twos, fours}
+ */
+static inline std::array<SpinLattice2levelPacked::Word, 3>
+countBits(SpinLattice2levelPacked::Word a0, SpinLattice2levelPacked::Word a1, SpinLattice2levelPacked::Word a2,
+          SpinLattice2levelPacked::Word a3) {
+    const auto low0 = a0 ^ a1;
+    const auto high0 = a0 & a1;
+    const auto low1 = a2 ^ a3;
+    const auto high1 = a2 & a3;
+    const auto carry = low0 & low1;
+    return {low0 ^ low1, high0 ^ high1 ^ carry, (high0 & high1) | (carry & (high0 ^ high1))};
+}
+
+/**
+ * sets or clears every bit of exactly one class c (count==c) with the bernoulli-mask of that class
+ * @return bits which are set
+ */
+static inline SpinLattice2levelPacked::Word
+selectByCount(const std::array<SpinLattice2levelPacked::Word, 3> &count,
+              const std::array<std::uint32_t, 5> &probabilities, SpinLattice2level::Rng &rng) {
+    const auto [ones, twos, fours] = count;
+    const std::array<SpinLattice2levelPacked::Word, 5> classes{~(ones | twos | fours), ones & ~twos, twos & ~ones,
+                                                               ones & twos, fours};
+    SpinLattice2levelPacked::Word result = 0;
+    for (size_t c = 0; c < classes.size(); ++c) {
+        if (classes[c] != 0) {
+            result |= classes[c] & bernoulliWord(probabilities[c], rng);
+        }
+    }
+    return result;
+}
+
+/**
+ * updates all words of the lattice with a kernel, one sublattice of the checkerboard after the other
+ * @param kernel function (spins, left, right, up, down, rng) returning the new spins of the word
+ */
+template<typename Kernel>
+static void checkerboardWordSweep(SpinLattice2levelPacked &spinLattice, Kernel kernel) {
+    const unsigned int sights = spinLattice.getSights();
+    const unsigned int wordsPerRow = spinLattice.getWordsPerRow();
+    auto &words = spinLattice.getWords();
+    for (unsigned int colour = 0; colour < 2; ++colour) {
+        for (unsigned int y = 0; y < sights; ++y) {
+            SpinLattice2levelPacked::Word *row = &words[static_cast<size_t>(y) * wordsPerRow];
+            const SpinLattice2levelPacked::Word *up = &words[static_cast<size_t>((y + sights - 1) % sights) *
+                                                             wordsPerRow];
+            const SpinLattice2levelPacked::Word *down = &words[static_cast<size_t>((y + 1) % sights) * wordsPerRow];
+            for (unsigned int k = 0; k < wordsPerRow; ++k) {
+                const auto mask = spinLattice.sublatticeMask(k, y, colour);
+                if (mask == 0) {
+                    continue;
+                }
+                const auto newSpins = kernel(row[k], leftWord(row, k, wordsPerRow), rightWord(row, k, wordsPerRow),
+                                             up[k], down[k], spinLattice.rng);
+                row[k] = (row[k] & ~mask) | (newSpins & mask);
+            }
+        }
+    }
+    spinLattice.performedSweeps++;
+}
+
+void metropolisSweep(SpinLattice2levelPacked &spinLattice, const float &temp) {
+    // acceptance probability by number of antiparallel neighbours m: deltaE = 2J(4 - 2m)
+    std::array<std::uint32_t, 5> acceptance{};
+    for (int m = 0; m < 5; ++m) {
+        const int deltaE = 2 * spinLattice.J * (4 - 2 * m);
+        acceptance[m] = deltaE <= 0 ? bernoulliOne : quantizeProbability(
+                std::exp(static_cast<double>(-1 * deltaE) / temp));
+    }
+
+    checkerboardWordSweep(spinLattice, [&acceptance](auto s, auto l, auto r, auto u, auto d, auto &rng) {
+        const auto flip = selectByCount(countBits(s ^ l, s ^ r, s ^ u, s ^ d), acceptance, rng);
+        return s ^ flip;
+    });
+}
+
+void metropolisSweep(SpinLattice2levelPacked &spinLattice, const float &temp, const unsigned int &iterations) {
+    for (size_t i = 0; i < iterations; ++i) {
+        metropolisSweep(spinLattice, temp);
+    }
+}
+
+void heatBathSweep(SpinLattice2levelPacked &spinLattice, const float &temp) {
+    // probability for spin +1 by number of up-neighbours u: sum of neighbours is 2u - 4
+    std::array<std::uint32_t, 5> upProbability{};
+    for (int u = 0; u < 5; ++u) {
+        const double k = static_cast<double>(spinLattice.J * (2 * u - 4)) / temp;
+        upProbability[u] = quantizeProbability(1.0 / (1.0 + std::exp(-2.0 * k)));
+    }
+
+    checkerboardWordSweep(spinLattice, [&upProbability](auto, auto l, auto r, auto u, auto d, auto &rng) {
+        return selectByCount(countBits(l, r, u, d), upProbability, rng);
+    });
+}
+
+void heatBathSweep(SpinLattice2levelPacked &spinLattice, const float &temp, const unsigned int &iterations) {
+    for (size_t i = 0; i < iterations; ++i) {
+        heatBathSweep(spinLattice, temp);
+    }
+}
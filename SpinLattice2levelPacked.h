@@ -0,0 +1,157 @@
+//
+// Created by chris on 17.10.26.
+//
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "SpinLattice2level.h"
+
+/**
+ * a quadratic 2-level ising-lattice with multi-spin coding: 64 spins are packed into one uint64_t.
+ *
+ * A set bit is spin +1, a cleared bit is spin -1. Word k of row y holds the sites x = b * wordsPerRow + k for
+ * the bits b = 0..63, so the left/right neighbours of a whole word are the words k-1/k+1 (rotated by one bit at
+ * the row boundary) and the upper/lower neighbours are the words with the same k in the rows y-1/y+1.
+ * This way a sweep updates 64 spins with a few bitwise operations. No extern magnetic field is supported.
+ *
+ * sights has to be a multiple of 64.
+ */
+class SpinLattice2levelPacked {
+public:
+    typedef std::uint64_t Word;
+
+    /**
+     * initialize a packed ising-lattice with sights² spins and no external magnetic field
+     * @param sights length of the quadratic lattice, must be a multiple of 64
+     */
+    explicit SpinLattice2levelPacked(unsigned int sights);
+
+    /**
+     * packs the spins of a given lattice
+     * @param sl lattice with a size which is a multiple of 64 and without extern magnetic field
+     */
+    explicit SpinLattice2levelPacked(const SpinLattice2level &sl);
+
+    /**
+     * Copy-constructor: Doesn't initialize random.
+     * @param sl
+     */
+    SpinLattice2levelPacked(const SpinLattice2levelPacked &sl);
+
+    ~SpinLattice2levelPacked() = default;
+
+
+    // prints a matrix-scheme to the console
+    void printSpins() const;
+
+    // Reinitialize all spins with random values
+    void initRandom();
+
+    // Reinitialize all spins with -1
+    void initCold();
+
+    // Restart the random number generator with a given seed
+    void seed(std::uint64_t seed);
+
+    /**
+     * unpacks all spins into a lattice with one short per spin, e.g. to plot them with the RuntimeGUI
+     * @return lattice with the same spins
+     */
+    [[nodiscard]] SpinLattice2level unpack() const;
+
+
+    inline short operator()(unsigned int x, unsigned int y) const {
+#ifdef DEBUG
+        assert(x < sights && y < sights);
+#endif
+        return (words[x % wordsPerRow + y * wordsPerRow] >> (x / wordsPerRow) & 1u) ? 1 : -1;
+    }
+
+    inline void setSpin(unsigned int x, unsigned int y, short spin) {
+#ifdef DEBUG
+        assert(x < sights && y < sights);
+#endif
+        const Word bit = Word(1) << (x / wordsPerRow);
+        Word &w = words[x % wordsPerRow + y * wordsPerRow];
+        w = spin == 1 ? (w | bit) : (w & ~bit);
+    }
+
+    /**
+     * calculates normalized energy of system like SpinLattice2level::calcEnergy
+     * complexity: O(N^2/64)
+     * @return energy between 0 and 1
+     */
+    [[nodiscard]] float calcEnergy() const;
+
+    /**
+     *calculates normalized magnetization: sum over all spins, divided by N²
+     * @return magnetization between -1 and 1
+     */
+    [[nodiscard]] float calcMagnetization() const;
+
+    /**
+     * @return sum of s_i * s_j over all bonds like SpinLattice2level::getBondSum, but counted from the words
+     * complexity: O(N^2/64)
+     */
+    [[nodiscard]] long long getBondSum() const;
+
+    /**
+     * @return sum over all spins like SpinLattice2level::getSpinSum, but counted from the words
+     * complexity: O(N^2/64)
+     */
+    [[nodiscard]] long long getSpinSum() const;
+
+
+    [[nodiscard]] inline unsigned int getSights() const {
+        return sights;
+    }
+
+    [[nodiscard]] inline unsigned int getWordsPerRow() const {
+        return wordsPerRow;
+    }
+
+    [[nodiscard]] inline const std::vector<Word> &getWords() const {
+        return words;
+    }
+
+    [[nodiscard]] inline std::vector<Word> &getWords() {
+        return words;
+    }
+
+    /**
+     * mask of all bits in word (k,y) which belong to the given sublattice of the checkerboard
+     * @param k index of the word in row y
+     * @param y row
+     * @param colour 0 for sites with even x+y, 1 for odd x+y
+     */
+    [[nodiscard]] inline Word sublatticeMask(unsigned int k, unsigned int y, unsigned int colour) const {
+        // colour of bit b is (b * wordsPerRow + k + y) % 2
+        const bool oddBits = ((k + y) & 1u) != colour;
+        if (wordsPerRow % 2 == 0) {// all bits of one word have the same colour
+            return oddBits ? 0 : ~Word(0);
+        }
+        // colours of neighbouring bits alternate
+        return oddBits ? 0xAAAAAAAAAAAAAAAAull : 0x5555555555555555ull;
+    }
+
+    int J;
+
+    unsigned int performedSweeps;
+
+    SpinLattice2level::Rng rng;
+private:
+    unsigned int sights;
+    unsigned int wordsPerRow;
+    std::vector<Word> words;
+};
+
+void metropolisSweep(SpinLattice2levelPacked &spinLattice, const float &temp);
+
+void metropolisSweep(SpinLattice2levelPacked &spinLattice, const float &temp, const unsigned int &iterations);
+
+void heatBathSweep(SpinLattice2levelPacked &spinLattice, const float &temp);
+
+void heatBathSweep(SpinLattice2levelPacked &spinLattice, const float &temp, const unsigned int &iterations);
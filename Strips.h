@@ -0,0 +1,142 @@
+//
+// Created by chris on 17.10.26.
+//
+#pragma once
+
+#include <barrier>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Domain decomposition of one lattice: the rows are split into strips of nearly the same height, every strip is
+ * worked on by its own thread.
+ */
+
+/**
+ * @return first row of a strip, stripBegin(strips, ...) is the number of rows
+ */
+inline unsigned int stripBegin(unsigned int strip, unsigned int strips, unsigned int rows) {
+    return static_cast<unsigned int>(static_cast<unsigned long long>(strip) * rows / strips);
+}
+
+/**
+ * Runs work(strip, sync) for every strip on its own thread, strip 0 runs on the calling thread. sync is a barrier of
+ * all strips, e.g. between the two half-sweeps of a checkerboard. Returns when all strips are done.
+ */
+template<typename Work>
+void runStrips(unsigned int strips, Work &&work) {
+    std::barrier sync(static_cast<std::ptrdiff_t>(strips));
+    std::vector<std::thread> workers;
+    workers.reserve(strips - 1);
+    for (unsigned int strip = 1; strip < strips; ++strip) {
+        workers.emplace_back([&work, &sync, strip]() {
+            work(strip, sync);
+        });
+    }
+    work(0u, sync);
+    for (auto &w : workers) {
+        w.join();
+    }
+}
+
+/**
+ * Persistent threads of runStrips for one lattice. The workers are started with the first run of more strips than
+ * before and then wait for the next run, so a sweep costs a wake-up instead of starting and joining threads. strip 0
+ * runs on the calling thread like with runStrips. Only one thread may call run at a time. Copies start without
+ * workers.
+ */
+class StripWorkers {
+public:
+    StripWorkers() : syncStrips(0), strips(0), pending(0), generation(0), stop(false) {}
+
+    StripWorkers(const StripWorkers &) : StripWorkers() {}
+
+    StripWorkers &operator=(const StripWorkers &) {
+        return *this;
+    }
+
+    ~StripWorkers() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        for (auto &w : workers) {
+            w.join();
+        }
+    }
+
+    /**
+     * like runStrips(numOfStrips, work), returns when all strips are done
+     */
+    template<typename Work>
+    void run(unsigned int numOfStrips, Work &&work) {
+        // the barrier only changes between two runs, when no strip waits at it
+        if (!sync || syncStrips != numOfStrips) {
+            sync = std::make_unique<std::barrier<>>(static_cast<std::ptrdiff_t>(numOfStrips));
+            syncStrips = numOfStrips;
+        }
+        if (numOfStrips <= 1) {
+            work(0u, *sync);
+            return;
+        }
+        while (workers.size() + 1 < numOfStrips) {
+            const auto strip = static_cast<unsigned int>(workers.size() + 1);
+            workers.emplace_back([this, strip, seen = generation]() { serve(strip, seen); });
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = [&work](unsigned int strip, std::barrier<> &barrier) { work(strip, barrier); };
+            strips = numOfStrips;
+            pending = numOfStrips - 1;
+            generation++;
+        }
+        wake.notify_all();
+        work(0u, *sync);
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this]() { return pending == 0; });
+    }
+
+private:
+    void serve(unsigned int strip, std::uint64_t seen) {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this, seen]() { return stop || generation != seen; });
+            if (stop) {
+                return;
+            }
+            seen = generation;
+            // workers of more strips than this run has sleep on
+            if (strip < strips) {
+                lock.unlock();
+                job(strip, *sync);
+                lock.lock();
+                if (--pending == 0) {
+                    finished.notify_one();
+                }
+            }
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::unique_ptr<std::barrier<>> sync;
+    // strips of sync, only used by the caller of run
+    unsigned int syncStrips;
+    // work of the current run, only replaced while all workers wait
+    std::function<void(unsigned int, std::barrier<> &)> job;
+    // strips of the current run
+    unsigned int strips;
+    // workers which didn't finish the current run yet
+    unsigned int pending;
+    // number of runs, a worker starts when it changes
+    std::uint64_t generation;
+    bool stop;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+};
@@ -0,0 +1,358 @@
+//
+// Created by chris on 17.10.26.
+//
+#include "SweepKernels.h"
+
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+#define ISING_X86_KERNELS
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+/// Scalar kernels, also used for the borders of the vectorized ones
+////////////////////////////////////////////////////////////////////////////////
+
+static inline int neighbourSum(const RowKernelArgs &a, unsigned int x) {
+    const short left = x == 0 ? a.row[a.sights - 1] : a.row[x - 1];
+    const short right = x + 1 == a.sights ? a.row[0] : a.row[x + 1];
+    return left + right + a.up[x] + a.down[x];
+}
+
+static inline void metropolisSites(const RowKernelArgs &a, unsigned int from, unsigned int to, RowDelta &delta) {
+    for (unsigned int x = from; x < to; x += 2) {
+        const short s = a.row[x];
+        const int sum = neighbourSum(a, x);
+        if (a.random[(x - a.firstX) / 2] < a.table[(s > 0 ? 8 : 0) + ((sum + 4) >> 1)]) {
+            a.row[x] = static_cast<short>(-s);
+            delta.spinSum -= 2 * s;
+            delta.bondSum -= 2 * s * sum;
+        }
+    }
+}
+
+static inline void heatBathSites(const RowKernelArgs &a, unsigned int from, unsigned int to, RowDelta &delta) {
+    for (unsigned int x = from; x < to; x += 2) {
+        const short s = a.row[x];
+        const int sum = neighbourSum(a, x);
+        const short newSpin = a.random[(x - a.firstX) / 2] < a.table[(sum + 4) >> 1] ? 1 : -1;
+        a.row[x] = newSpin;
+        delta.spinSum += newSpin - s;
+        delta.bondSum += (newSpin - s) * sum;
+    }
+}
+
+static RowDelta metropolisRowScalar(const RowKernelArgs &a) {
+    RowDelta delta{};
+    metropolisSites(a, a.firstX, a.sights, delta);
+    return delta;
+}
+
+static RowDelta heatBathRowScalar(const RowKernelArgs &a) {
+    RowDelta delta{};
+    heatBathSites(a, a.firstX, a.sights, delta);
+    return delta;
+}
+
+#ifdef ISING_X86_KERNELS
+
+////////////////////////////////////////////////////////////////////////////////
+/// AVX2: 16 shorts per register, the 8 sites of one colour are the low halves of the 32-bit lanes
+////////////////////////////////////////////////////////////////////////////////
+
+__attribute__((target("avx2")))
+static inline __m256i lowSpins256(const short *p) {
+    const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    return _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i neighbourSum256(const RowKernelArgs &a, unsigned int x) {
+    return _mm256_add_epi32(_mm256_add_epi32(lowSpins256(a.row + x - 1), lowSpins256(a.row + x + 1)),
+                            _mm256_add_epi32(lowSpins256(a.up + x), lowSpins256(a.down + x)));
+}
+
+/// r < threshold for unsigned 32-bit lanes
+__attribute__((target("avx2")))
+static inline __m256i lessThan256(const __m256i r, const __m256i threshold) {
+    const __m256i sign = _mm256_set1_epi32(INT32_MIN);
+    return _mm256_cmpgt_epi32(_mm256_xor_si256(threshold, sign), _mm256_xor_si256(r, sign));
+}
+
+/// writes the new spins into the low halves and keeps the other colour in the high halves
+__attribute__((target("avx2")))
+static inline void storeLowSpins256(short *p, const __m256i spins) {
+    const __m256i old = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    const __m256i merged = _mm256_blend_epi16(old, spins, 0x55);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), merged);
+}
+
+/// changes of the spins and bonds of all lanes, see RowDelta
+__attribute__((target("avx2")))
+static inline void accumulateDelta256(__m256i &spinDelta, __m256i &bondDelta, const __m256i oldSpins,
+                                      const __m256i newSpins, const __m256i sum) {
+    const __m256i d = _mm256_sub_epi32(newSpins, oldSpins);
+    spinDelta = _mm256_add_epi32(spinDelta, d);
+    bondDelta = _mm256_add_epi32(bondDelta, _mm256_mullo_epi32(d, sum));
+}
+
+__attribute__((target("avx2")))
+static inline int horizontalSum256(const __m256i v) {
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+}
+
+/**
+ * first x of the vector loop: the loads of the left neighbours need x >= 1, sites before are updated scalar
+ */
+static inline unsigned int vectorStart(const RowKernelArgs &a, RowDelta &delta,
+                                       void (*scalar)(const RowKernelArgs &, unsigned int, unsigned int, RowDelta &)) {
+    if (a.firstX == 0) {
+        scalar(a, 0, 1, delta);
+        return 2;
+    }
+    return a.firstX;
+}
+
+__attribute__((target("avx2")))
+static RowDelta metropolisRowAvx2(const RowKernelArgs &a) {
+    const __m256i tableDown = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a.table));
+    const __m256i tableUp = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a.table + 8));
+    const __m256i four = _mm256_set1_epi32(4);
+    const __m256i one = _mm256_set1_epi32(1);
+    RowDelta delta{};
+    __m256i spinDelta = _mm256_setzero_si256();
+    __m256i bondDelta = _mm256_setzero_si256();
+    // the loads of the right neighbours need x + 16 < sights
+    unsigned int x = vectorStart(a, delta, metropolisSites);
+    for (; x + 16 < a.sights; x += 16) {
+        const __m256i s = lowSpins256(a.row + x);
+        const __m256i sum = neighbourSum256(a, x);
+        const __m256i index = _mm256_srli_epi32(_mm256_add_epi32(sum, four), 1);
+        // the spin is -1 or 1, so its sign bit selects the table
+        const __m256i threshold = _mm256_castps_si256(
+                _mm256_blendv_ps(_mm256_castsi256_ps(_mm256_permutevar8x32_epi32(tableUp, index)),
+                                 _mm256_castsi256_ps(_mm256_permutevar8x32_epi32(tableDown, index)),
+                                 _mm256_castsi256_ps(s)));
+        const __m256i r = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a.random + (x - a.firstX) / 2));
+        const __m256i flip = lessThan256(r, threshold);
+        // s * -1 where flip is set, s * 1 otherwise
+        const __m256i newSpins = _mm256_sign_epi32(s, _mm256_or_si256(flip, one));
+        storeLowSpins256(a.row + x, newSpins);
+        accumulateDelta256(spinDelta, bondDelta, s, newSpins, sum);
+    }
+    metropolisSites(a, x, a.sights, delta);
+    delta.spinSum += horizontalSum256(spinDelta);
+    delta.bondSum += horizontalSum256(bondDelta);
+    return delta;
+}
+
+__attribute__((target("avx2")))
+static RowDelta heatBathRowAvx2(const RowKernelArgs &a) {
+    const __m256i table = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a.table));
+    const __m256i four = _mm256_set1_epi32(4);
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i two = _mm256_set1_epi32(2);
+    RowDelta delta{};
+    __m256i spinDelta = _mm256_setzero_si256();
+    __m256i bondDelta = _mm256_setzero_si256();
+    unsigned int x = vectorStart(a, delta, heatBathSites);
+    for (; x + 16 < a.sights; x += 16) {
+        const __m256i s = lowSpins256(a.row + x);
+        const __m256i sum = neighbourSum256(a, x);
+        const __m256i index = _mm256_srli_epi32(_mm256_add_epi32(sum, four), 1);
+        const __m256i threshold = _mm256_permutevar8x32_epi32(table, index);
+        const __m256i r = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a.random + (x - a.firstX) / 2));
+        const __m256i up = lessThan256(r, threshold);
+        // 2 - 1 where up is set, 0 - 1 otherwise
+        const __m256i newSpins = _mm256_sub_epi32(_mm256_and_si256(up, two), one);
+        storeLowSpins256(a.row + x, newSpins);
+        accumulateDelta256(spinDelta, bondDelta, s, newSpins, sum);
+    }
+    heatBathSites(a, x, a.sights, delta);
+    delta.spinSum += horizontalSum256(spinDelta);
+    delta.bondSum += horizontalSum256(bondDelta);
+    return delta;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// AVX-512: 32 shorts per register, 16 sites of one colour
+////////////////////////////////////////////////////////////////////////////////
+
+#define ISING_AVX512_TARGET __attribute__((target("avx512f,avx512bw")))
+
+// gcc 12 warns about the _mm512_undefined_epi32() inside the shift and reduce intrinsics
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+
+ISING_AVX512_TARGET
+static inline __m512i lowSpins512(const short *p) {
+    const __m512i v = _mm512_loadu_si512(p);
+    return _mm512_srai_epi32(_mm512_slli_epi32(v, 16), 16);
+}
+
+ISING_AVX512_TARGET
+static inline __m512i neighbourSum512(const RowKernelArgs &a, unsigned int x) {
+    return _mm512_add_epi32(_mm512_add_epi32(lowSpins512(a.row + x - 1), lowSpins512(a.row + x + 1)),
+                            _mm512_add_epi32(lowSpins512(a.up + x), lowSpins512(a.down + x)));
+}
+
+ISING_AVX512_TARGET
+static inline void storeLowSpins512(short *p, const __m512i spins) {
+    // every even short belongs to the updated colour
+    _mm512_mask_storeu_epi16(p, 0x55555555u, spins);
+}
+
+ISING_AVX512_TARGET
+static inline void accumulateDelta512(__m512i &spinDelta, __m512i &bondDelta, const __m512i oldSpins,
+                                      const __m512i newSpins, const __m512i sum) {
+    const __m512i d = _mm512_sub_epi32(newSpins, oldSpins);
+    spinDelta = _mm512_add_epi32(spinDelta, d);
+    bondDelta = _mm512_add_epi32(bondDelta, _mm512_mullo_epi32(d, sum));
+}
+
+ISING_AVX512_TARGET
+static RowDelta metropolisRowAvx512(const RowKernelArgs &a) {
+    const __m512i table = _mm512_loadu_si512(a.table);
+    const __m512i four = _mm512_set1_epi32(4);
+    const __m512i eight = _mm512_set1_epi32(8);
+    RowDelta delta{};
+    __m512i spinDelta = _mm512_setzero_si512();
+    __m512i bondDelta = _mm512_setzero_si512();
+    unsigned int x = vectorStart(a, delta, metropolisSites);
+    for (; x + 32 < a.sights; x += 32) {
+        const __m512i s = lowSpins512(a.row + x);
+        const __m512i sum = neighbourSum512(a, x);
+        const __m512i sumIndex = _mm512_srli_epi32(_mm512_add_epi32(sum, four), 1);
+        const __m512i index = _mm512_mask_add_epi32(sumIndex, _mm512_cmpgt_epi32_mask(s, _mm512_setzero_si512()),
+                                                    sumIndex, eight);
+        const __m512i threshold = _mm512_permutexvar_epi32(index, table);
+        const __m512i r = _mm512_loadu_si512(a.random + (x - a.firstX) / 2);
+        const __mmask16 flip = _mm512_cmplt_epu32_mask(r, threshold);
+        const __m512i newSpins = _mm512_mask_sub_epi32(s, flip, _mm512_setzero_si512(), s);
+        storeLowSpins512(a.row + x, newSpins);
+        accumulateDelta512(spinDelta, bondDelta, s, newSpins, sum);
+    }
+    metropolisSites(a, x, a.sights, delta);
+    delta.spinSum += _mm512_reduce_add_epi32(spinDelta);
+    delta.bondSum += _mm512_reduce_add_epi32(bondDelta);
+    return delta;
+}
+
+ISING_AVX512_TARGET
+static RowDelta heatBathRowAvx512(const RowKernelArgs &a) {
+    const __m512i table = _mm512_loadu_si512(a.table);
+    const __m512i four = _mm512_set1_epi32(4);
+    const __m512i minusOne = _mm512_set1_epi32(-1);
+    const __m512i one = _mm512_set1_epi32(1);
+    RowDelta delta{};
+    __m512i spinDelta = _mm512_setzero_si512();
+    __m512i bondDelta = _mm512_setzero_si512();
+    unsigned int x = vectorStart(a, delta, heatBathSites);
+    for (; x + 32 < a.sights; x += 32) {
+        const __m512i s = lowSpins512(a.row + x);
+        const __m512i sum = neighbourSum512(a, x);
+        const __m512i index = _mm512_srli_epi32(_mm512_add_epi32(sum, four), 1);
+        const __m512i threshold = _mm512_permutexvar_epi32(index, table);
+        const __m512i r = _mm512_loadu_si512(a.random + (x - a.firstX) / 2);
+        const __mmask16 up = _mm512_cmplt_epu32_mask(r, threshold);
+        const __m512i newSpins = _mm512_mask_mov_epi32(minusOne, up, one);
+        storeLowSpins512(a.row + x, newSpins);
+        accumulateDelta512(spinDelta, bondDelta, s, newSpins, sum);
+    }
+    heatBathSites(a, x, a.sights, delta);
+    delta.spinSum += _mm512_reduce_add_epi32(spinDelta);
+    delta.bondSum += _mm512_reduce_add_epi32(bondDelta);
+    return delta;
+}
+
+#pragma GCC diagnostic pop
+
+#endif //ISING_X86_KERNELS
+
+////////////////////////////////////////////////////////////////////////////////
+/// Runtime dispatch
+////////////////////////////////////////////////////////////////////////////////
+
+KernelIsa detectKernelIsa() {
+#ifdef ISING_X86_KERNELS
+    static const KernelIsa detected = []() {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+            return KernelIsa::AVX512;
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            return KernelIsa::AVX2;
+        }
+        return KernelIsa::Scalar;
+    }();
+    return detected;
+#else
+    return KernelIsa::Scalar;
+#endif
+}
+
+static std::atomic<KernelIsa> &activeIsa() {
+    static std::atomic<KernelIsa> isa(detectKernelIsa());
+    return isa;
+}
+
+KernelIsa getKernelIsa() {
+    return activeIsa().load(std::memory_order_relaxed);
+}
+
+void setKernelIsa(KernelIsa isa) {
+    // the order of the enum is the order of the feature sets
+    activeIsa().store(static_cast<int>(isa) <= static_cast<int>(detectKernelIsa()) ? isa : detectKernelIsa());
+}
+
+const char *kernelIsaName(KernelIsa isa) {
+    switch (isa) {
+        case KernelIsa::AVX512:
+            return "AVX-512";
+        case KernelIsa::AVX2:
+            return "AVX2";
+        default:
+            return "scalar";
+    }
+}
+
+RowKernel metropolisRowKernel() {
+    return metropolisRowKernel(getKernelIsa());
+}
+
+RowKernel metropolisRowKernel(KernelIsa isa) {
+    switch (isa) {
+#ifdef ISING_X86_KERNELS
+        case KernelIsa::AVX512:
+            return metropolisRowAvx512;
+        case KernelIsa::AVX2:
+            return metropolisRowAvx2;
+#endif
+        default:
+            return metropolisRowScalar;
+    }
+}
+
+RowKernel heatBathRowKernel() {
+    return heatBathRowKernel(getKernelIsa());
+}
+
+RowKernel heatBathRowKernel(KernelIsa isa) {
+    switch (isa) {
+#ifdef ISING_X86_KERNELS
+        case KernelIsa::AVX512:
+            return heatBathRowAvx512;
+        case KernelIsa::AVX2:
+            return heatBathRowAvx2;
+#endif
+        default:
+            return heatBathRowScalar;
+    }
+}
@@ -0,0 +1,82 @@
+//
+// Created by chris on 17.10.26.
+//
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Row kernels for the checkerboard sweeps of SpinLattice2level. One call updates all sites of one colour in one row.
+ * Every site consumes exactly one random number, in ascending x, so all instruction sets produce the same lattice.
+ * The vectorized kernels load whole registers of the neighbour rows and store the other colour of the row unchanged,
+ * only the scalar ones access nothing but the needed sites.
+ */
+
+enum class KernelIsa {
+    Scalar,
+    AVX2,
+    AVX512
+};
+
+/**
+ * arguments for one row of a half-sweep
+ */
+struct RowKernelArgs {
+    short *row;
+    const short *up;
+    const short *down;
+    // one random number for every updated site of this row
+    const std::uint32_t *random;
+    // thresholds (P * 2^32) for the sum of neighbours, indexed with (sum + 4) / 2 (+ 8 for spin 1 in Metropolis)
+    const std::uint32_t *table;
+    unsigned int sights;
+    // first updated x, every second site after it is updated as well
+    unsigned int firstX;
+};
+
+/**
+ * change of the running totals of SpinLattice2level by the updated sites of one row
+ */
+struct RowDelta {
+    // change of the sum of all spins
+    int spinSum;
+    // change of the sum over all bonds: (new spin - old spin) * sum of neighbours for every site
+    int bondSum;
+};
+
+typedef RowDelta (*RowKernel)(const RowKernelArgs &args);
+
+/**
+ * Metropolis: flips a spin s if random < table[(s > 0 ? 8 : 0) + (sum + 4) / 2]
+ */
+[[nodiscard]] RowKernel metropolisRowKernel();
+
+/**
+ * @return Metropolis kernel of the given instruction set, e.g. the scalar one which only touches the updated sites
+ */
+[[nodiscard]] RowKernel metropolisRowKernel(KernelIsa isa);
+
+/**
+ * heat-bath: sets a spin to 1 if random < table[(sum + 4) / 2], otherwise to -1
+ */
+[[nodiscard]] RowKernel heatBathRowKernel();
+
+[[nodiscard]] RowKernel heatBathRowKernel(KernelIsa isa);
+
+/**
+ * @return the best instruction set the CPU supports
+ */
+[[nodiscard]] KernelIsa detectKernelIsa();
+
+/**
+ * @return the instruction set the kernels use, detectKernelIsa() unless set with setKernelIsa
+ */
+[[nodiscard]] KernelIsa getKernelIsa();
+
+/**
+ * Forces the kernels to an instruction set, e.g. to compare them. Falls back to the detected one if the CPU doesn't
+ * support the given instruction set.
+ */
+void setKernelIsa(KernelIsa isa);
+
+[[nodiscard]] const char *kernelIsaName(KernelIsa isa);
@@ -0,0 +1,146 @@
+//
+// Created by chris on 17.10.26.
+//
+#include "SwendsenWangEngine.h"
+#include "SpinLattice2level.h"
+
+#include <algorithm>
+
+void SwendsenWangEngine::prepare(unsigned int numOfSights, unsigned int numOfStrips) {
+    if (sights == numOfSights && strips == numOfStrips) {
+        return;
+    }
+    sights = numOfSights;
+    strips = numOfStrips;
+    label.assign(static_cast<size_t>(sights) * sights, 0);
+    borderBonds.assign(static_cast<size_t>(strips) * sights, 0);
+    stripBonds.assign(strips, 0);
+    stripSpins.assign(strips, 0);
+}
+
+std::uint32_t SwendsenWangEngine::find(std::uint32_t site) {
+    // path halving
+    while (label[site] != site) {
+        label[site] = label[label[site]];
+        site = label[site];
+    }
+    return site;
+}
+
+void SwendsenWangEngine::unite(std::uint32_t a, std::uint32_t b) {
+    a = find(a);
+    b = find(b);
+    // the smaller site becomes the root, so the root doesn't depend on the order of the unions
+    if (a < b) {
+        label[b] = a;
+    } else if (b < a) {
+        label[a] = b;
+    }
+}
+
+std::uint32_t SwendsenWangEngine::clusterOf(std::uint32_t site) const {
+    while (label[site] != site) {
+        site = label[site];
+    }
+    return site;
+}
+
+void SwendsenWangEngine::labelStrip(const SpinLattice2level &sl, unsigned int strip, const std::uint32_t threshold,
+                                    const std::uint64_t bondSeed) {
+    const unsigned int begin = stripBegin(strip);
+    const unsigned int end = stripBegin(strip + 1);
+    const short *spins = sl.getSpins().data();
+    for (std::uint32_t site = begin * sights; site < end * sights; ++site) {
+        label[site] = site;
+    }
+    for (unsigned int y = begin; y < end; ++y) {
+        // every row has its own stream, independent of the strips
+        Xoshiro256ss rng(deriveSeed(bondSeed, {y}));
+        const std::uint32_t row = y * sights;
+        const std::uint32_t downRow = y + 1 == sights ? 0 : row + sights;
+        for (unsigned int x = 0; x < sights; ++x) {
+            // the high half decides about the right bond, the low half about the lower bond
+            const std::uint64_t r = rng();
+            const std::uint32_t site = row + x;
+            const std::uint32_t right = row + (x + 1 == sights ? 0 : x + 1);
+            if (spins[site] == spins[right] && static_cast<std::uint32_t>(r >> 32) < threshold) {
+                unite(site, right);
+            }
+            const bool down = spins[site] == spins[downRow + x] && static_cast<std::uint32_t>(r) < threshold;
+            if (y + 1 < end) {
+                if (down) {
+                    unite(site, downRow + x);
+                }
+            } else {
+                borderBonds[static_cast<size_t>(strip) * sights + x] = down;
+            }
+        }
+    }
+}
+
+void SwendsenWangEngine::uniteStrips() {
+    for (unsigned int strip = 0; strip < strips; ++strip) {
+        const unsigned int last = stripBegin(strip + 1) - 1;
+        const std::uint32_t row = last * sights;
+        const std::uint32_t downRow = last + 1 == sights ? 0 : row + sights;
+        for (unsigned int x = 0; x < sights; ++x) {
+            if (borderBonds[static_cast<size_t>(strip) * sights + x]) {
+                unite(row + x, downRow + x);
+            }
+        }
+    }
+}
+
+void SwendsenWangEngine::flipStrip(SpinLattice2level &sl, unsigned int strip, const std::uint64_t flipSeed) const {
+    short *spins = &sl(0, 0);
+    for (std::uint32_t site = stripBegin(strip) * sights; site < stripBegin(strip + 1) * sights; ++site) {
+        // one random bit per cluster, derived from its root
+        std::uint64_t state = flipSeed ^ clusterOf(site);
+        if (splitMix64(state) >> 63) {
+            spins[site] = static_cast<short>(-spins[site]);
+        }
+    }
+}
+
+void SwendsenWangEngine::countStrip(const SpinLattice2level &sl, unsigned int strip, long long &bonds,
+                                    long long &spins) const {
+    bonds = 0;
+    spins = 0;
+    const short *s = sl.getSpins().data();
+    for (unsigned int y = stripBegin(strip); y < stripBegin(strip + 1); ++y) {
+        const short *row = s + static_cast<size_t>(y) * sights;
+        const short *down = s + static_cast<size_t>(y + 1 == sights ? 0 : y + 1) * sights;
+        for (unsigned int x = 0; x < sights; ++x) {
+            bonds += row[x] * ((x + 1 == sights ? row[0] : row[x + 1]) + down[x]);
+            spins += row[x];
+        }
+    }
+}
+
+void SwendsenWangEngine::sweep(SpinLattice2level &sl, const float bondProbability, unsigned int threads) {
+    prepare(sl.getSights(), std::clamp(threads, 1u, sl.getSights()));
+    const auto threshold = static_cast<std::uint32_t>(
+            std::clamp(static_cast<double>(bondProbability) * 4294967296.0, 0.0, 4294967295.0));
+    const std::uint64_t bondSeed = sl.rng();
+    const std::uint64_t flipSeed = sl.rng();
+
+    sl.workers.run(strips, [&](unsigned int strip, auto &sync) {
+        labelStrip(sl, strip, threshold, bondSeed);
+        sync.arrive_and_wait();
+        if (strip == 0) {
+            uniteStrips();
+        }
+        sync.arrive_and_wait();
+        flipStrip(sl, strip, flipSeed);
+        sync.arrive_and_wait();
+        countStrip(sl, strip, stripBonds[strip], stripSpins[strip]);
+    });
+
+    long long bondSum = 0;
+    long long spinSum = 0;
+    for (unsigned int strip = 0; strip < strips; ++strip) {
+        bondSum += stripBonds[strip];
+        spinSum += stripSpins[strip];
+    }
+    sl.updateTotals(spinSum - sl.getSpinSum(), bondSum - sl.getBondSum());
+}
@@ -0,0 +1,85 @@
+//
+// Created by chris on 17.10.26.
+//
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Strips.h"
+
+class SpinLattice2level;
+
+/**
+ * Swendsen-Wang multi-cluster update for one lattice. The bonds between parallel neighbours are activated with
+ * probability 1 - exp(-2J/T), the connected components are labelled with a union-find and every cluster is flipped
+ * with probability 1/2.
+ *
+ * The lattice is split into strips of rows, one per thread: every thread activates the bonds and unites the sites
+ * inside its strip, the bonds across the borders of the strips are united afterwards. The root of a cluster is always
+ * its smallest site and the random numbers are drawn per row and per root, so the result doesn't depend on the number
+ * of threads.
+ *
+ * The buffers are allocated once per lattice and number of strips, the strips run on the StripWorkers of the lattice.
+ */
+class SwendsenWangEngine {
+public:
+    SwendsenWangEngine() : sights(0), strips(0) {}
+
+    /**
+     * Copy-constructor: Doesn't copy the buffers, they are allocated again with the first sweep.
+     */
+    SwendsenWangEngine(const SwendsenWangEngine &) : SwendsenWangEngine() {}
+
+    SwendsenWangEngine &operator=(const SwendsenWangEngine &) {
+        return *this;
+    }
+
+    /**
+     * flips all clusters with probability 1/2, the running totals of sl are recalculated
+     * @param bondProbability probability 1 - exp(-2J/T) to activate the bond between parallel neighbours
+     * @param threads number of threads, at most one per row
+     */
+    void sweep(SpinLattice2level &sl, float bondProbability, unsigned int threads);
+
+    /**
+     * @param site x + y * sights
+     * @return smallest site of the cluster of the given site in the last sweep
+     */
+    [[nodiscard]] std::uint32_t clusterOf(std::uint32_t site) const;
+
+private:
+    // allocates the buffers, if not done yet
+    void prepare(unsigned int numOfSights, unsigned int numOfStrips);
+
+    // first row of a strip
+    [[nodiscard]] inline unsigned int stripBegin(unsigned int strip) const {
+        return ::stripBegin(strip, strips, sights);
+    }
+
+    std::uint32_t find(std::uint32_t site);
+
+    void unite(std::uint32_t a, std::uint32_t b);
+
+    // activates the bonds of the rows of one strip and unites the sites inside the strip
+    void labelStrip(const SpinLattice2level &sl, unsigned int strip, std::uint32_t threshold, std::uint64_t bondSeed);
+
+    // unites the active bonds from the last row of every strip to the next strip
+    void uniteStrips();
+
+    // flips the clusters of one strip, the labels are only read
+    void flipStrip(SpinLattice2level &sl, unsigned int strip, std::uint64_t flipSeed) const;
+
+    // sum over the bonds (right and lower neighbour) and the spins of one strip
+    void countStrip(const SpinLattice2level &sl, unsigned int strip, long long &bonds, long long &spins) const;
+
+    unsigned int sights;
+    unsigned int strips;
+    // parent of every site in the union-find, roots point to themselves
+    std::vector<std::uint32_t> label;
+    // for the last row of every strip: 1 if the bond to the lower neighbour is active
+    std::vector<std::uint8_t> borderBonds;
+    // sums of countStrip of every strip
+    std::vector<long long> stripBonds;
+    std::vector<long long> stripSpins;
+};
@@ -0,0 +1,271 @@
+//
+// Created by chris on 17.10.26.
+//
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Work-stealing thread pool: every worker has its own queue. Tasks are submitted round-robin to the queues, a worker
+ * takes the oldest task of its own queue and steals the oldest task of another queue when its own is empty.
+ * So tasks which take much longer than others don't keep the remaining tasks of their queue waiting. Submit expensive
+ * tasks first: then the stolen task is always the most expensive one left.
+ *
+ * Tasks may wait for a TaskGroup of the same pool: the waiting worker runs queued tasks meanwhile, so nested groups
+ * don't block the pool. wait() of the pool itself must not be called from a task.
+ */
+class ThreadPool {
+public:
+    /**
+     * @param threads number of workers, at least 1
+     */
+    explicit ThreadPool(unsigned int threads) : queued(0), unfinished(0), next(0), stop(false) {
+        threads = std::max(threads, 1u);
+        for (unsigned int i = 0; i < threads; ++i) {
+            queues.push_back(std::make_unique<Queue>());
+        }
+        for (unsigned int i = 0; i < threads; ++i) {
+            workers.emplace_back([this, i]() { work(i); });
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * finishes all submitted tasks, then stops the workers
+     */
+    ~ThreadPool() {
+        wait();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        wake.notify_all();
+        for (auto &w : workers) {
+            w.join();
+        }
+    }
+
+    /**
+     * queues a task, tasks submitted first are started first as long as no worker steals
+     */
+    void submit(std::function<void()> task) {
+        Queue &queue = *queues[next++ % queues.size()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(std::move(task));
+        }
+        {
+            // a worker can only take the task after this, see work()
+            std::lock_guard<std::mutex> lock(mutex);
+            ++queued;
+            ++unfinished;
+        }
+        wake.notify_one();
+    }
+
+    /**
+     * blocks until all submitted tasks are finished
+     */
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]() { return unfinished == 0; });
+    }
+
+    /**
+     * blocks until all submitted tasks are finished or the timeout expired
+     * @return true if all tasks are finished
+     */
+    template<typename Rep, typename Period>
+    bool waitFor(const std::chrono::duration<Rep, Period> &timeout) {
+        std::unique_lock<std::mutex> lock(mutex);
+        return done.wait_for(lock, timeout, [this]() { return unfinished == 0; });
+    }
+
+    [[nodiscard]] unsigned int size() const {
+        return static_cast<unsigned int>(workers.size());
+    }
+
+    /**
+     * @return true if the calling thread is one of the workers of this pool
+     */
+    [[nodiscard]] bool isWorker() const {
+        return currentPool == this;
+    }
+
+    /**
+     * runs the oldest queued task on the calling worker, e.g. while a task of the pool waits for a TaskGroup
+     * @return false if the caller is no worker of this pool or no task is queued
+     */
+    bool runQueued() {
+        if (!isWorker()) {
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (queued == 0) {
+                return false;
+            }
+            --queued;
+        }
+        runReserved(currentWorker);
+        return true;
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    /**
+     * takes the oldest task of the own queue, or of the next queue which is not empty
+     * @return false if all queues are empty
+     */
+    bool take(unsigned int self, std::function<void()> &task) {
+        for (size_t i = 0; i < queues.size(); ++i) {
+            Queue &queue = *queues[(self + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.tasks.empty()) {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // takes a task reserved by decrementing queued and runs it
+    void runReserved(unsigned int self) {
+        // a task is reserved by the decrement, so it is found in one of the queues
+        std::function<void()> task;
+        while (!take(self, task)) {
+            std::this_thread::yield();
+        }
+        task();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--unfinished == 0) {
+                done.notify_all();
+            }
+        }
+    }
+
+    void work(unsigned int self) {
+        currentPool = this;
+        currentWorker = self;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]() { return stop || queued > 0; });
+                if (queued == 0) {// stop and nothing left
+                    return;
+                }
+                --queued;
+            }
+            runReserved(self);
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    // guards queued, unfinished and stop
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    // tasks in the queues which are not reserved by a worker yet
+    size_t queued;
+    // submitted tasks which are not finished yet
+    size_t unfinished;
+    std::atomic<unsigned int> next;
+    bool stop;
+    // pool and queue of the worker the calling thread is, nullptr for other threads
+    static inline thread_local const ThreadPool *currentPool = nullptr;
+    static inline thread_local unsigned int currentWorker = 0;
+};
+
+/**
+ * Tasks of one caller on a shared ThreadPool: wait() only waits for the tasks of this group, not for the tasks other
+ * callers submitted to the same pool. The destructor waits for the tasks of the group.
+ */
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool &pool) : pool(pool), unfinished(0) {}
+
+    TaskGroup(const TaskGroup &) = delete;
+
+    TaskGroup &operator=(const TaskGroup &) = delete;
+
+    ~TaskGroup() {
+        wait();
+    }
+
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++unfinished;
+        }
+        pool.submit([this, task = std::move(task)]() {
+            task();
+            // notified under the lock, so the group can't be destroyed before
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--unfinished == 0) {
+                done.notify_all();
+            }
+        });
+    }
+
+    /**
+     * blocks until all tasks of the group are finished. Called from a task of the same pool, e.g. by a nested group,
+     * the worker runs queued tasks until the group is finished, otherwise the pool could run out of workers.
+     */
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (unfinished != 0 && pool.isWorker()) {
+            lock.unlock();
+            const bool ran = pool.runQueued();
+            lock.lock();
+            // the last tasks of the group run on other workers, check for new tasks now and then
+            if (!ran) {
+                done.wait_for(lock, std::chrono::milliseconds(1), [this]() { return unfinished == 0; });
+            }
+        }
+        done.wait(lock, [this]() { return unfinished == 0; });
+    }
+
+    /**
+     * blocks until all tasks of the group are finished or the timeout expired
+     * @return true if all tasks are finished
+     */
+    template<typename Rep, typename Period>
+    bool waitFor(const std::chrono::duration<Rep, Period> &timeout) {
+        std::unique_lock<std::mutex> lock(mutex);
+        return done.wait_for(lock, timeout, [this]() { return unfinished == 0; });
+    }
+
+private:
+    ThreadPool &pool;
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t unfinished;
+};
+
+/**
+ * @return pool with one worker per hardware thread, created with the first call and kept until the program ends.
+ * All simulations of a run share it, so cores are never split between several pools.
+ */
+inline ThreadPool &sharedPool() {
+    static ThreadPool pool(std::thread::hardware_concurrency());
+    return pool;
+}
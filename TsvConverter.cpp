@@ -0,0 +1,424 @@
+//
+// Created by chris on 17.10.26.
+//
+#include "TsvConverter.h"
+#include "MeasurementWriter.h"
+#include "SpinLattice2level.h"
+#include "Strips.h"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <memory>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    // measurements per buffer of a channel, every thread has a channel per (N, T, chain) of its lines
+    constexpr size_t convertBufferSize = 1 << 12;
+
+    // exact powers of ten of a double
+    constexpr double powersOfTen[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13,
+                                      1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    struct TsvRow {
+        unsigned int sights;
+        float temp;
+        float magnetization;
+        float energy;
+        unsigned int chain;
+        long long bondSum;
+        long long spinSum;
+        // bond and spin sum are in the file or reproduce the energy and magnetization
+        bool exact;
+    };
+
+    // rows of one (N, T, chain) in the lines of one thread
+    struct KeyCount {
+        unsigned int sights;
+        std::uint32_t tempBits;
+        unsigned int chain;
+        // index in the keys of all threads
+        size_t merged;
+        size_t count;
+        size_t inexact;
+        long long bondSum;
+        long double bondSquares;
+        long long absSpinSum;
+        long double spinSquares;
+    };
+
+    bool isDigit(char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    bool isSpace(char c) {
+        return c == '\t' || c == ' ' || c == '\r';
+    }
+
+    // data lines start with a number, everything else is the header
+    bool isDataLine(const char *pos, const char *end) {
+        return pos != end && (isDigit(*pos) || *pos == '-' || *pos == '+' || *pos == '.');
+    }
+
+    /**
+     * parses a decimal number like "0.1234567890" or "-1.5e-3" at pos. The digits are collected as an integer and
+     * divided by an exact power of ten, which is the correctly rounded result for up to 19 digits and exponents up
+     * to 22, i.e. everything ising-headless writes. Other numbers are parsed by std::from_chars.
+     * @return end of the number, nullptr if there is none
+     */
+    const char *parseFloat(const char *pos, const char *end, float &value) {
+        const char *begin = pos;
+        const bool negative = pos != end && *pos == '-';
+        if (pos != end && (*pos == '-' || *pos == '+')) {
+            ++pos;
+        }
+        std::uint64_t mantissa = 0;
+        int digits = 0;
+        int exponent = 0;
+        bool any = false;
+        for (; pos != end && isDigit(*pos); ++pos, any = true) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + static_cast<unsigned int>(*pos - '0');
+                digits += mantissa != 0;
+            } else {
+                ++exponent;
+            }
+        }
+        if (pos != end && *pos == '.') {
+            for (++pos; pos != end && isDigit(*pos); ++pos, any = true) {
+                if (digits < 19) {
+                    mantissa = mantissa * 10 + static_cast<unsigned int>(*pos - '0');
+                    digits += mantissa != 0;
+                    --exponent;
+                }
+            }
+        }
+        if (!any) {
+            return nullptr;
+        }
+        if (pos != end && (*pos == 'e' || *pos == 'E')) {
+            int sign = 1;
+            const char *exp = pos + 1;
+            if (exp != end && (*exp == '-' || *exp == '+')) {
+                sign = *exp++ == '-' ? -1 : 1;
+            }
+            int given = 0;
+            const char *expBegin = exp;
+            for (; exp != end && isDigit(*exp) && given < 10000; ++exp) {
+                given = given * 10 + (*exp - '0');
+            }
+            if (exp != expBegin) {
+                exponent += sign * given;
+                pos = exp;
+            }
+        }
+        if (mantissa < (std::uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+            double result = static_cast<double>(mantissa);
+            result = exponent < 0 ? result / powersOfTen[-exponent] : result * powersOfTen[exponent];
+            value = static_cast<float>(negative ? -result : result);
+            return pos;
+        }
+        // from_chars doesn't accept a leading +
+        const auto parsed = std::from_chars(*begin == '+' ? begin + 1 : begin, end, value);
+        return parsed.ec == std::errc() ? parsed.ptr : nullptr;
+    }
+
+    const char *parseInteger(const char *pos, const char *end, long long &value) {
+        const auto parsed = std::from_chars(pos, end, value);
+        return parsed.ec == std::errc() ? parsed.ptr : nullptr;
+    }
+
+    [[noreturn]] void parseError(const char *line, const char *end) {
+        std::cerr << "Can't parse the line \"" << std::string(line, std::find(line, end, '\n')) << "\".\n";
+        exit(21);
+    }
+
+    /**
+     * parses a data line at pos
+     * @return begin of the next line
+     */
+    const char *parseRow(const char *pos, const char *end, TsvRow &row) {
+        const char *line = pos;
+        long long fields[3] = {0, 0, 0};
+        float floats[3];
+        long long sights = 0;
+        // N, temp, magnetization, energy and optional chain, bondSum, spinSum
+        int numOfFields = 0;
+        for (; numOfFields < 7; ++numOfFields) {
+            while (pos != end && isSpace(*pos)) {
+                ++pos;
+            }
+            if (pos == end || *pos == '\n') {
+                break;
+            }
+            if (numOfFields == 0) {
+                pos = parseInteger(pos, end, sights);
+            } else if (numOfFields < 4) {
+                pos = parseFloat(pos, end, floats[numOfFields - 1]);
+            } else {
+                pos = parseInteger(pos, end, fields[numOfFields - 4]);
+            }
+            if (pos == nullptr || (pos != end && !isSpace(*pos) && *pos != '\n')) {
+                parseError(line, end);
+            }
+        }
+        while (pos != end && isSpace(*pos)) {
+            ++pos;
+        }
+        if ((numOfFields != 4 && numOfFields != 5 && numOfFields != 7) || (pos != end && *pos != '\n') ||
+            sights <= 0 || sights > UINT32_MAX || fields[0] < 0 || fields[0] > UINT32_MAX) {
+            parseError(line, end);
+        }
+        row.sights = static_cast<unsigned int>(sights);
+        row.temp = floats[0];
+        row.magnetization = floats[1];
+        row.energy = floats[2];
+        row.chain = static_cast<unsigned int>(fields[0]);
+        // energy and magnetization as sums, inverse of SpinLattice2level::normalizedEnergy with J = 1 and
+        // normalizedMagnetization
+        const auto numOfSpins = static_cast<double>(sights) * static_cast<double>(sights);
+        const double bondSum = (0.5 - static_cast<double>(row.energy)) * 4 * numOfSpins;
+        const double spinSum = static_cast<double>(row.magnetization) * numOfSpins;
+        if (numOfFields == 7) {
+            row.bondSum = fields[1];
+            row.spinSum = fields[2];
+        } else {
+            // 2N² bonds of +-1 have an even sum, N² spins a sum with the parity of N²
+            const long long parity = static_cast<long long>(row.sights % 2);
+            row.bondSum = 2 * std::llround(bondSum / 2);
+            row.spinSum = parity + 2 * std::llround((spinSum - static_cast<double>(parity)) / 2);
+        }
+        // neighbouring sums are 2 apart, in the middle between two the sum is a guess
+        row.exact = std::abs(bondSum - static_cast<double>(row.bondSum)) <= 0.75 &&
+                    std::abs(spinSum - static_cast<double>(row.spinSum)) <= 0.75;
+        return pos == end ? end : pos + 1;
+    }
+
+    // first line of the data after the given position, lines are split at the first new line after it
+    const char *lineAfter(const char *begin, const char *end, size_t offset) {
+        if (offset == 0) {
+            return begin;
+        }
+        const char *pos = static_cast<const char *>(std::memchr(begin + offset - 1, '\n', end - begin - offset + 1));
+        return pos == nullptr ? end : pos + 1;
+    }
+}
+
+std::vector<TsvBlockStats> convertTsv(const std::string &tsvPath, const std::string &binaryPath, unsigned int threads) {
+    const int fd = open(tsvPath.c_str(), O_RDONLY);
+    struct stat info{};
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        std::cerr << "Can't open the result file " << tsvPath << ".\n";
+        exit(20);
+    }
+    const auto size = static_cast<size_t>(info.st_size);
+    const char *data = nullptr;
+    if (size > 0) {
+        void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            std::cerr << "Can't map the result file " << tsvPath << ".\n";
+            exit(20);
+        }
+        // every line is read twice, from the front to the back
+        madvise(mapped, size, MADV_SEQUENTIAL);
+        data = static_cast<const char *>(mapped);
+    }
+    close(fd);
+    const char *end = data + size;
+
+    // the seed is in the header of ising-headless
+    std::uint64_t seed = 0;
+    for (const char *line = data; line != end && !isDataLine(line, end);) {
+        const char *next = lineAfter(data, end, line - data + 1);
+        constexpr char seedKey[] = "seed:";
+        if (static_cast<size_t>(end - line) > sizeof(seedKey) && std::memcmp(line, seedKey, sizeof(seedKey) - 1) == 0) {
+            const char *pos = line + sizeof(seedKey) - 1;
+            while (pos != next && isSpace(*pos)) {
+                ++pos;
+            }
+            std::from_chars(pos, next, seed);
+        }
+        line = next;
+    }
+
+    threads = std::max(threads, 1u);
+    std::vector<std::vector<KeyCount>> keysOfThread(threads);
+    // keys of all threads in the order of their first row, and the block of each
+    std::vector<KeyCount> keys;
+    std::vector<unsigned int> blockOfKey;
+    // first measurement of the rows of every thread in the block of each key, in the order of keysOfThread
+    std::vector<std::vector<std::uint64_t>> firstOfThread(threads);
+    std::vector<TsvBlockStats> stats;
+    MeasurementWriter writer(binaryPath, ResultFormat::Binary, "", convertBufferSize);
+
+    runStrips(threads, [&](unsigned int thread, auto &sync) {
+        const char *begin = lineAfter(data, end, static_cast<size_t>(
+                static_cast<unsigned long long>(thread) * size / threads));
+        const char *stop = lineAfter(data, end, static_cast<size_t>(
+                static_cast<unsigned long long>(thread + 1) * size / threads));
+        auto &ownKeys = keysOfThread[thread];
+        // the rows of one key come in long runs, so the last key is checked first
+        auto findKey = [&ownKeys](const TsvRow &row, size_t last) {
+            const std::uint32_t tempBits = std::bit_cast<std::uint32_t>(row.temp);
+            auto matches = [&](const KeyCount &key) {
+                return key.sights == row.sights && key.tempBits == tempBits && key.chain == row.chain;
+            };
+            if (last < ownKeys.size() && matches(ownKeys[last])) {
+                return last;
+            }
+            for (size_t k = 0; k < ownKeys.size(); ++k) {
+                if (matches(ownKeys[k])) {
+                    return k;
+                }
+            }
+            ownKeys.push_back({row.sights, tempBits, row.chain, 0, 0, 0, 0, 0, 0, 0});
+            return ownKeys.size() - 1;
+        };
+
+        // pass 1: count the rows of every key
+        TsvRow row{};
+        size_t last = 0;
+        for (const char *line = begin; line != stop;) {
+            if (!isDataLine(line, stop)) {
+                line = lineAfter(data, stop, line - data + 1);
+                continue;
+            }
+            line = parseRow(line, stop, row);
+            last = findKey(row, last);
+            KeyCount &key = ownKeys[last];
+            ++key.count;
+            key.inexact += !row.exact;
+            key.bondSum += row.bondSum;
+            key.bondSquares += static_cast<long double>(row.bondSum) * static_cast<long double>(row.bondSum);
+            key.absSpinSum += std::abs(row.spinSum);
+            key.spinSquares += static_cast<long double>(row.spinSum) * static_cast<long double>(row.spinSum);
+        }
+        sync.arrive_and_wait();
+
+        if (thread == 0) {
+            // merge the keys, the chains of a block one after the other
+            std::vector<std::vector<std::uint64_t>> firstOfKey(threads);
+            for (unsigned int t = 0; t < threads; ++t) {
+                for (auto &key : keysOfThread[t]) {
+                    size_t k = 0;
+                    while (k < keys.size() && (keys[k].sights != key.sights || keys[k].tempBits != key.tempBits ||
+                                               keys[k].chain != key.chain)) {
+                        ++k;
+                    }
+                    if (k == keys.size()) {
+                        keys.push_back(key);
+                        keys.back().count = 0;
+                    }
+                    key.merged = k;
+                    // rows of this key before the ones of thread t
+                    firstOfKey[t].push_back(keys[k].count);
+                    keys[k].count += key.count;
+                }
+            }
+            std::vector<ResultBlock> blocks;
+            for (const auto &key : keys) {
+                unsigned int b = 0;
+                while (b < blocks.size() && (blocks[b].sights != key.sights ||
+                                             std::bit_cast<std::uint32_t>(blocks[b].temp) != key.tempBits)) {
+                    ++b;
+                }
+                if (b == blocks.size()) {
+                    ResultBlock block{};
+                    block.sights = key.sights;
+                    block.temp = std::bit_cast<float>(key.tempBits);
+                    // the TSV doesn't have the algorithm and the sweeps of the run
+                    block.algorithm = resultUnknown;
+                    block.sweepsPerIteration = resultUnknown;
+                    block.thermalizeSweeps = resultUnknown;
+                    block.J = 1;
+                    block.seed = seed;
+                    blocks.push_back(block);
+                    stats.push_back({key.sights, block.temp, 0, 0, 0, 0, 0, 0});
+                }
+                blockOfKey.push_back(b);
+                blocks[b].chains = std::max(blocks[b].chains, key.chain + 1);
+            }
+            // first measurement of every key in its block
+            std::vector<std::uint64_t> firstInBlock(keys.size(), 0);
+            for (unsigned int b = 0; b < blocks.size(); ++b) {
+                for (unsigned int chain = 0; chain < blocks[b].chains; ++chain) {
+                    for (size_t k = 0; k < keys.size(); ++k) {
+                        if (blockOfKey[k] == b && keys[k].chain == chain) {
+                            firstInBlock[k] = blocks[b].count;
+                            blocks[b].count += keys[k].count;
+                        }
+                    }
+                }
+            }
+            for (const auto &block : blocks) {
+                writer.addBlock(block);
+            }
+            for (unsigned int t = 0; t < threads; ++t) {
+                for (size_t i = 0; i < keysOfThread[t].size(); ++i) {
+                    const size_t k = keysOfThread[t][i].merged;
+                    firstOfThread[t].push_back(firstInBlock[k] + firstOfKey[t][i]);
+                }
+            }
+        }
+        sync.arrive_and_wait();
+
+        // pass 2: stream the rows to their places in the blocks
+        std::vector<std::unique_ptr<MeasurementWriter::Channel>> channels(ownKeys.size());
+        last = 0;
+        for (const char *line = begin; line != stop;) {
+            if (!isDataLine(line, stop)) {
+                line = lineAfter(data, stop, line - data + 1);
+                continue;
+            }
+            line = parseRow(line, stop, row);
+            last = findKey(row, last);
+            if (channels[last] == nullptr) {
+                const unsigned int block = blockOfKey[ownKeys[last].merged];
+                channels[last] = std::make_unique<MeasurementWriter::Channel>(writer, block, row.chain,
+                                                                              firstOfThread[thread][last]);
+            }
+            channels[last]->push(row.bondSum, row.spinSum);
+        }
+    });
+    writer.close();
+    if (data != nullptr) {
+        munmap(const_cast<char *>(data), size);
+    }
+
+    // moments of the exact sums of every block, energy and magnetization are linear in them
+    std::vector<long long> bondSums(stats.size(), 0), absSpinSums(stats.size(), 0);
+    std::vector<long double> bondSquares(stats.size(), 0), spinSquares(stats.size(), 0);
+    for (const auto &ownKeys : keysOfThread) {
+        for (const auto &key : ownKeys) {
+            const unsigned int b = blockOfKey[key.merged];
+            stats[b].count += key.count;
+            stats[b].inexact += key.inexact;
+            bondSums[b] += key.bondSum;
+            absSpinSums[b] += key.absSpinSum;
+            bondSquares[b] += key.bondSquares;
+            spinSquares[b] += key.spinSquares;
+        }
+    }
+    for (size_t b = 0; b < stats.size(); ++b) {
+        auto &block = stats[b];
+        const auto n = static_cast<long double>(block.count);
+        const long double numOfSpins = static_cast<long double>(block.sights) * block.sights;
+        const long double meanBond = bondSums[b] / n;
+        const long double meanAbsSpin = absSpinSums[b] / n;
+        block.meanEnergy = static_cast<double>(0.5L - meanBond / (4 * numOfSpins));
+        block.meanAbsMagnetization = static_cast<double>(meanAbsSpin / numOfSpins);
+        if (block.count > 1) {
+            block.varEnergy = static_cast<double>((bondSquares[b] - bondSums[b] * meanBond) / (n - 1) /
+                                                  (16 * numOfSpins * numOfSpins));
+            block.varAbsMagnetization = static_cast<double>((spinSquares[b] - absSpinSums[b] * meanAbsSpin) /
+                                                            (n - 1) / (numOfSpins * numOfSpins));
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,43 @@
+//
+// Created by chris on 17.10.26.
+//
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * statistics of the measurements of one (N, T) of a TSV file
+ */
+struct TsvBlockStats {
+    unsigned int sights;
+    float temp;
+    size_t count;
+    double meanEnergy;
+    double varEnergy;
+    double meanAbsMagnetization;
+    double varAbsMagnetization;
+    // rows whose energy or magnetization is too far from its recovered bond or spin sum, the sum may be wrong by 2
+    size_t inexact;
+};
+
+/**
+ * Converts a TSV result file of ising-headless (N, temp, magnetization, energy and optional chain, bondSum, spinSum)
+ * to the binary format of ResultFile, one block per (N, T) in the order of the first row of each.
+ *
+ * The file is memory-mapped and split into one range of lines per thread. In a first pass every thread counts its rows
+ * per (N, T, chain), which gives every row its place in the block. In a second pass every thread parses its range
+ * again and streams the rows to the writer. Lines which don't start with a number (the header) are skipped, a
+ * "seed:" line is kept in the blocks.
+ *
+ * Old files have no bond and spin sums: they are recovered from the energy and magnetization with J = 1. The bond sum
+ * is even and the spin sum has the parity of N², so the sums are exact up to N = 512 with the 6 decimals of the old
+ * ising-headless and up to about N = 2000 with 10 decimals, where the float measurements themselves are too coarse.
+ * Rows which don't fit a sum are counted as inexact.
+ *
+ * Exits if the file can't be read or a data line can't be parsed.
+ * @param threads number of threads, at least 1
+ * @return statistics of every block, in the order of the blocks of the binary file
+ */
+std::vector<TsvBlockStats> convertTsv(const std::string &tsvPath, const std::string &binaryPath, unsigned int threads);
@@ -0,0 +1,60 @@
+//
+// Created by chris on 17.10.26.
+//
+#include "WolffEngine.h"
+#include "SpinLattice2level.h"
+
+void WolffEngine::prepare(std::uint32_t numOfSites) {
+    if (sites == numOfSites) {
+        return;
+    }
+    sites = numOfSites;
+    // every site enters the queue at most once
+    queue.assign(sites, 0);
+    clusterSize = 0;
+}
+
+unsigned int WolffEngine::flipCluster(SpinLattice2level &sl, const float bondProbability) {
+    const unsigned int sights = sl.getSights();
+    prepare(sights * sights);
+
+    // spins are flipped when they are added, so a flipped spin is never added again
+    short *spins = &sl(0, 0);
+    const std::uint32_t x0 = sl.rng.bounded(sights);
+    const std::uint32_t y0 = sl.rng.bounded(sights);
+    const short clusterSpin = spins[x0 + y0 * sights];
+    long long flippedNeighbourSum = 0;
+
+    auto add = [&](std::uint32_t site, std::uint32_t x, std::uint32_t y) {
+        const std::uint32_t row = y * sights;
+        flippedNeighbourSum += spins[(x + 1 == sights ? 0 : x + 1) + row] + spins[(x == 0 ? sights : x) - 1 + row] +
+                               spins[x + (y + 1 == sights ? 0 : row + sights)] +
+                               spins[x + (y == 0 ? sites : row) - sights];
+        spins[site] = static_cast<short>(-clusterSpin);
+        queue[clusterSize++] = site;
+    };
+
+    clusterSize = 0;
+    add(x0 + y0 * sights, x0, y0);
+    for (unsigned int head = 0; head < clusterSize; ++head) {
+        const std::uint32_t site = queue[head];
+        const std::uint32_t x = site % sights;
+        const std::uint32_t y = site / sights;
+        // same order as SpinLattice2level::getNeighbours
+        const std::uint32_t right = x + 1 == sights ? 0 : x + 1;
+        const std::uint32_t down = y + 1 == sights ? 0 : y + 1;
+        const std::uint32_t left = x == 0 ? sights - 1 : x - 1;
+        const std::uint32_t up = y == 0 ? sights - 1 : y - 1;
+        const std::uint32_t neighbours[4][2] = {{right, y}, {x, down}, {left, y}, {x, up}};
+        for (const auto &n : neighbours) {
+            const std::uint32_t neighbour = n[0] + n[1] * sights;
+            if (spins[neighbour] == clusterSpin && bondProbability > sl.rng.uniformFloat()) {
+                add(neighbour, n[0], n[1]);
+            }
+        }
+    }
+
+    // every flip changes the bonds to the current neighbours by -2 * clusterSpin * neighbour
+    sl.updateTotals(-2LL * clusterSpin * clusterSize, -2LL * clusterSpin * flippedNeighbourSum);
+    return clusterSize;
+}
@@ -0,0 +1,59 @@
+//
+// Created by chris on 17.10.26.
+//
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+class SpinLattice2level;
+
+/**
+ * Buffer of the Wolff cluster algorithm for one lattice: a queue of the sites of the cluster, allocated once with the
+ * first cluster, so growing and flipping a cluster afterwards doesn't touch the heap. Above T_c the clusters are tiny
+ * and this overhead was most of the time of a wolffSweep. The spins are flipped when they are added, so a site is in
+ * the cluster iff its spin isn't the cluster spin anymore, no extra marker is needed.
+ */
+class WolffEngine {
+public:
+    WolffEngine() : sites(0), clusterSize(0) {}
+
+    /**
+     * Copy-constructor: Doesn't copy the buffers, they are allocated again with the first cluster.
+     */
+    WolffEngine(const WolffEngine &) : WolffEngine() {}
+
+    WolffEngine &operator=(const WolffEngine &) {
+        return *this;
+    }
+
+    /**
+     * grows a cluster from a random site and flips it, the running totals of sl are updated
+     * @param bondProbability probability 1 - exp(-2J/T) to add a parallel neighbour to the cluster
+     * @return number of sites in the cluster
+     */
+    unsigned int flipCluster(SpinLattice2level &sl, float bondProbability);
+
+    /**
+     * linear search of the queue, only meant for tests
+     * @param site x + y * sights
+     * @return true if the site belongs to the last flipped cluster
+     */
+    [[nodiscard]] bool inLastCluster(std::uint32_t site) const {
+        return std::find(queue.begin(), queue.begin() + clusterSize, site) != queue.begin() + clusterSize;
+    }
+
+    [[nodiscard]] inline unsigned int getLastClusterSize() const {
+        return clusterSize;
+    }
+
+private:
+    // allocates the buffers for a lattice with the given number of sites, if not done yet
+    void prepare(std::uint32_t numOfSites);
+
+    std::uint32_t sites;
+    // sites of the cluster in the order they were added, used as queue with a head index
+    std::vector<std::uint32_t> queue;
+    unsigned int clusterSize;
+};
@@ -0,0 +1,47 @@
+//
+// Created by chris on 17.10.26.
+//
+#include "TsvConverter.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+
+/**
+ * Converts a TSV result file of ising-headless to the binary format of ResultFile and prints the statistics of every
+ * (N, T):
+ *
+ *  ising-convert IsingResults.tsv [IsingResults.bin] [threads]
+ */
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " results.tsv [results.bin] [threads]\n";
+        return 1;
+    }
+    const std::string tsvPath = argv[1];
+    std::string binaryPath;
+    if (argc > 2) {
+        binaryPath = argv[2];
+    } else {
+        binaryPath = tsvPath.substr(0, tsvPath.rfind('.')) + ".bin";
+    }
+    const unsigned int threads = argc > 3 ? std::stoul(argv[3]) : std::max(std::thread::hardware_concurrency(), 1u);
+
+    const auto begin = std::chrono::steady_clock::now();
+    const auto stats = convertTsv(tsvPath, binaryPath, threads);
+    const auto end = std::chrono::steady_clock::now();
+
+    size_t rows = 0;
+    std::printf("%8s %12s %10s %14s %14s %14s %14s %10s\n", "N", "temp", "count", "<E>", "var(E)", "<|M|>",
+                "var(|M|)", "inexact");
+    for (const auto &block : stats) {
+        std::printf("%8u %12.8f %10zu %14.10f %14.6e %14.10f %14.6e %10zu\n", block.sights, block.temp, block.count,
+                    block.meanEnergy, block.varEnergy, block.meanAbsMagnetization, block.varAbsMagnetization,
+                    block.inexact);
+        rows += block.count;
+    }
+    std::cout << rows << " measurements converted to " << binaryPath << " in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+}
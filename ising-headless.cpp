@@ -3,6 +3,8 @@
 //
 #include "Simulation.h"
 
+#include <sstream>
+
 /** TASK 1:
  *
  * Simulate Systems with sight-size 128,256,512,1024
@@ -19,6 +21,17 @@ void simulateAndPlot() {
     const int numOfTemps = 16;
     const int numIterations = 1E5;
     const unsigned int shuffleAgainAfter = UINT32_MAX;
+    const Algorithm algorithm = Algorithm::Wolff;
+    // Checkerboard runs Metropolis and heat-bath with the vectorized kernels
+    const SweepOrder sweepOrder = SweepOrder::Checkerboard;
+    // threads per lattice of the checkerboard sweeps and Swendsen-Wang, for fewer temperatures than cores
+    const unsigned int threadsPerLattice = 1;
+    // Packed stores 64 spins per word, for Metropolis and heat-bath with N a multiple of 64
+    const LatticeType latticeType = LatticeType::Standard;
+    // Tsv for importMulti.m, Binary is smaller and read directly by ising-reweight and ising-resample
+    const ResultFormat resultFormat = ResultFormat::Tsv;
+    // set a fixed value to repeat a run, every (seed, N, T) gives the same measurements
+    const std::uint64_t seed = randomSeed();
 
     std::vector<Simulation> Sims = {
             //Simulation(16, numOfTemps, 1.5, 3.5, numIterations, shuffleAgainAfter),
@@ -32,29 +45,46 @@ void simulateAndPlot() {
     for (auto &S:Sims) {
         S.sweepsPerIteration = 5;
         S.thermalizeSweeps = 200;
+        S.seed = seed;
+        S.algorithm = algorithm;
+        S.sweepOrder = sweepOrder;
+        S.threadsPerLattice = threadsPerLattice;
+        S.latticeType = latticeType;
+        // bounded by N, not by the measurements, and enough to reweight energy and magnetization
+        S.collectHistograms = true;
     }
 
-    std::ofstream file("IsingResultsWolff1024.tsv");
-    file << "numOfTemps:\t" << numOfTemps << std::endl;
-    file << "numOfIterations:\t" << numIterations << std::endl << std::endl;
-    file << "N\ttemp\tmagnetization\tenergy\tsusceptibility\theatCapacity\n";
-    file << std::fixed;
-    file.precision(10);
+    // the header is only written to TSV files, the binary format has the parameters of every (N, T) in its index
+    std::stringstream parameters;
+    parameters << "numOfTemps:\t" << numOfTemps << std::endl;
+    parameters << "numOfIterations:\t" << numIterations << std::endl;
+    parameters << "seed:\t" << seed << std::endl;
+    const std::string header = parameters.str() + "N\ttemp\tmagnetization\tenergy\tchain\tbondSum\tspinSum\n";
+    // the measurements are written while the simulation runs
+    const std::string extension = resultFormat == ResultFormat::Tsv ? ".tsv" : ".bin";
+    MeasurementWriter writer("IsingResultsWolff1024" + extension, resultFormat, header);
     for (auto &S:Sims) {
-        std::cout << "Simulating now N=" << S.getSights() << "\n";
-        S.simulate_par();
-        std::cout << "Simulation finished. Save results now...\n";
-
-        /// Save measurements to file
-        for (size_t i = 0; i < S.getNumOfTemps() * S.getNumOfIterations(); ++i) {
-            file << S.getSights() << "\t" << S.getTemps()[i] << "\t"
-                 << S.getMagnetization()[i] << "\t" << S.getEnergies()[i] << "\n";
-        }
+        S.writer = &writer;
     }
 
-    file.close();
+    // all sizes in one batch, the largest lattices start first
+    Simulation::simulateAll(Sims);
+    writer.close();
+    std::cout << "Simulation finished. " << writer.getWrittenRows() << " measurements saved.\n";
 
+    // mean, heat capacity, susceptibility and Binder cumulant of every (N, T), accumulated while running
+    std::ofstream summary("IsingSummaryWolff1024.tsv");
+    summary << parameters.str();
+    for (size_t i = 0; i < Sims.size(); ++i) {
+        Sims[i].writeSummary(summary, i == 0);
+    }
 
+    // count of every (bondSum, spinSum) per (N, T), for reweighting
+    std::ofstream histograms("IsingHistogramsWolff1024.tsv");
+    histograms << parameters.str();
+    for (size_t i = 0; i < Sims.size(); ++i) {
+        Sims[i].writeHistograms(histograms, i == 0);
+    }
 }
 
 int main() {
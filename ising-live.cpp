@@ -121,12 +121,17 @@ void runIsingLive() {
     /// ---------------------------------------------------------------------------------------------------------------
 
     auto axesAC = CvPlot::makePlotAxes();
+    // all ensembles of all algorithms in one batch: metropolis, heat bath, wolff
+    std::vector<std::vector<float>> energyAll = energyMetro;
+    energyAll.insert(energyAll.end(), energyHB.begin(), energyHB.end());
+    energyAll.insert(energyAll.end(), energyWolff.begin(), energyWolff.end());
+    const auto acAll = autoCorr(energyAll);
     for (int i = 0; i < numEnsembles; ++i) {
-        std::vector<float> ac_metro = autoCorr(energyMetro[i]);
+        std::vector<float> ac_metro = acAll[i];
         normalize(ac_metro);
-        std::vector<float> ac_HB = autoCorr(energyHB[i]);
+        std::vector<float> ac_HB = acAll[numEnsembles + i];
         normalize(ac_HB);
-        std::vector<float> ac_wolff = autoCorr(energyWolff[i]);
+        std::vector<float> ac_wolff = acAll[2 * numEnsembles + i];
         normalize(ac_wolff);
         if (i == 0) {
             axesAC.create<CvPlot::Series>(ac_metro, "-g").setName("Metropolis (T=T_c)");
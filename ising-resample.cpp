@@ -0,0 +1,74 @@
+//
+// Created by chris on 17.10.26.
+//
+#include "Resampling.h"
+#include "ResultFile.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+/**
+ * Jackknife and bootstrap errors of heat capacity, susceptibility and Binder cumulant of every (N, T) of a binary
+ * result file. All blocks are resampled at once, every block is split into bins of consecutive measurements:
+ *
+ *  ising-resample IsingResults.bin [bins] [replicas] [seed]
+ */
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " results.bin [bins] [replicas] [seed]\n";
+        return 1;
+    }
+    const ResultFile file(argv[1]);
+    const unsigned int numOfBins = argc > 2 ? std::stoul(argv[2]) : 64;
+    const unsigned int replicas = argc > 3 ? std::stoul(argv[3]) : 1000;
+    const std::uint64_t seed = argc > 4 ? std::stoull(argv[4]) : 1;
+
+    const auto begin = std::chrono::steady_clock::now();
+    std::vector<ObservableBins> grid;
+    std::vector<size_t> binsPerSet;
+    for (size_t block = 0; block < file.getNumOfBlocks(); ++block) {
+        const ResultBlock &info = file.getBlock(block);
+        // measurements of an aborted run which were never written are 0
+        if (info.written < info.count) {
+            std::cerr << "Skipped N=" << info.sights << " T=" << info.temp << ", it is incomplete.\n";
+            continue;
+        }
+        grid.emplace_back(info.sights, info.temp, info.J, file.getBondSums(block), file.getSpinSums(block),
+                          numOfBins, false);
+        binsPerSet.push_back(grid.back().getNumOfBins());
+    }
+    // heat capacity, susceptibility and Binder cumulant of every block
+    const auto observables = [&grid](const Multiplicities &weights) {
+        std::vector<double> values;
+        values.reserve(3 * grid.size());
+        for (size_t k = 0; k < grid.size(); ++k) {
+            const auto point = grid[k].observables(weights[k]);
+            values.insert(values.end(), {point.heatCapacity, point.susceptibility, point.binderCumulant});
+        }
+        return values;
+    };
+    const Resampler resampler(binsPerSet);
+    const auto jackknife = resampler.jackknife(observables);
+    const auto bootstrap = resampler.bootstrap(observables, replicas, seed);
+    const auto end = std::chrono::steady_clock::now();
+
+    std::printf("%6s %12s %14s %12s %12s %14s %12s %12s %14s %12s %12s\n", "N", "temp", "heatCapacity", "jackError",
+                "bootError", "suscept", "jackError", "bootError", "binder", "jackError", "bootError");
+    size_t set = 0;
+    for (size_t block = 0; block < file.getNumOfBlocks(); ++block) {
+        const ResultBlock &info = file.getBlock(block);
+        if (info.written < info.count) {
+            continue;
+        }
+        std::printf("%6u %12.8f", info.sights, info.temp);
+        for (size_t v = 3 * set; v < 3 * set + 3; ++v) {
+            std::printf(" %14.8f %12.8f %12.8f", jackknife.estimate[v], jackknife.error[v], bootstrap.error[v]);
+        }
+        std::printf("\n");
+        set++;
+    }
+    std::cerr << grid.size() << " temperatures resampled with " << replicas << " bootstrap replicas in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+}
@@ -0,0 +1,79 @@
+//
+// Created by chris on 17.10.26.
+//
+#include "Reweighting.h"
+#include "ResultFile.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <thread>
+
+/**
+ * Multi-histogram reweighting of all temperatures of one lattice size of a binary result file, prints the observables
+ * on a dense temperature grid:
+ *
+ *  ising-reweight IsingResults.bin N Tmin Tmax [points] [threads]
+ */
+int main(int argc, char **argv) {
+    if (argc < 5) {
+        std::cerr << "usage: " << argv[0] << " results.bin N Tmin Tmax [points] [threads]\n";
+        return 1;
+    }
+    const ResultFile file(argv[1]);
+    const auto sights = static_cast<unsigned int>(std::stoul(argv[2]));
+    const float tempMin = std::stof(argv[3]);
+    const float tempMax = std::stof(argv[4]);
+    const unsigned int points = argc > 5 ? std::stoul(argv[5]) : 1000;
+    const unsigned int threads = argc > 6 ? std::stoul(argv[6]) : std::max(std::thread::hardware_concurrency(), 1u);
+
+    const auto begin = std::chrono::steady_clock::now();
+    std::optional<MultiHistogram> histogram;
+    int J = 0, h = 0;
+    for (size_t block = 0; block < file.getNumOfBlocks(); ++block) {
+        const ResultBlock &info = file.getBlock(block);
+        if (info.sights != sights) {
+            continue;
+        }
+        // measurements of an aborted run which were never written are 0
+        if (info.written < info.count) {
+            std::cerr << "Skipped T=" << info.temp << ", it is incomplete.\n";
+            continue;
+        }
+        if (!histogram) {
+            J = info.J;
+            h = info.h;
+            histogram.emplace(sights, J, h);
+        } else if (info.J != J || info.h != h) {
+            std::cerr << "Skipped T=" << info.temp << ", it has another J or h.\n";
+            continue;
+        }
+        histogram->addRun(info.temp, file.getBondSums(block), file.getSpinSums(block));
+    }
+    if (!histogram) {
+        std::cerr << "There are no measurements of N=" << sights << " in " << argv[1] << ".\n";
+        return 1;
+    }
+    if (!histogram->solve(threads)) {
+        std::cerr << "The free energies did not converge, the temperatures may not overlap.\n";
+    }
+    std::vector<float> temps(points);
+    for (unsigned int i = 0; i < points; ++i) {
+        temps[i] = points == 1 ? tempMin : tempMin + static_cast<float>(i) * (tempMax - tempMin) /
+                                                     static_cast<float>(points - 1);
+    }
+    const auto result = histogram->evaluate(temps, threads);
+    const auto end = std::chrono::steady_clock::now();
+
+    std::printf("%12s %14s %14s %14s %14s %14s %14s %14s\n", "temp", "energy", "absMagnet", "magnet^2", "magnet^4",
+                "heatCapacity", "suscept", "binder");
+    for (const auto &point : result) {
+        std::printf("%12.8f %14.10f %14.10f %14.10f %14.10f %14.8f %14.8f %14.10f\n", point.temp, point.meanEnergy,
+                    point.meanAbsMagnetization, point.meanMagnetizationSquared, point.meanMagnetizationFourth,
+                    point.heatCapacity, point.susceptibility, point.binderCumulant);
+    }
+    std::cerr << histogram->getTemps().size() << " temperatures reweighted in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << "[ms]" << std::endl;
+}
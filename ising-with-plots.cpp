@@ -11,6 +11,7 @@ void simulateAndPlot() {
     const float tempEnd = 3;
     const int numIterations = 1000;
     const unsigned int shuffleAgainAfter = UINT32_MAX;
+    const std::uint64_t seed = randomSeed();
 
     std::vector<Simulation> Sim = {Simulation(16, noOfTemps, tempStart, tempEnd, numIterations, shuffleAgainAfter),
                                    Simulation(32, noOfTemps, tempStart, tempEnd, numIterations, shuffleAgainAfter),
@@ -21,9 +22,9 @@ void simulateAndPlot() {
     for (auto &s:Sim) {
         s.thermalizeSweeps = 50;
         s.sweepsPerIteration = 2;
-        std::cout << "Simulating now N=" << s.getSights() << "\n";
-        s.simulate_seq();
+        s.seed = seed;
     }
+    Simulation::simulateAll(Sim);
 
     for (const auto &i : Sim[1].getEnergies()) {
         std::cout<<i<<std::endl;
@@ -63,7 +64,8 @@ void simulateAndPlot() {
     std::cout << "Simulation finished. Save results now...\n";
     std::ofstream file("IsingResultsTemp.tsv");
     file << "numOfTemps:\t" << noOfTemps << std::endl;
-    file << "numOfIterations:\t" << numIterations << std::endl << std::endl;
+    file << "numOfIterations:\t" << numIterations << std::endl;
+    file << "seed:\t" << seed << std::endl;
     file << "N\ttemp\tmagnetization\tenergy\n";
     file << std::fixed;
     file.precision(5);
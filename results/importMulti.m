@@ -4,7 +4,12 @@ numOfTemps=readmatrix(filename,"FileType","text","Delimiter","\t","Range",'B1:B1
 numOfIterations=readmatrix(filename,"FileType","text","Delimiter","\t","Range",'B2:B2');
 %it=numOfTemps*numOfIterations;
 
-import=readmatrix(filename,"FileType","text","Delimiter","\t","Range",[5,1,1E8,4]); %assume file is never longer than 1E8 rows
+%columns: N, temp, magnetization, energy[, chain, bondSum, spinSum], the exact sums in 6 and 7 aren't needed here
+import=readmatrix(filename,"FileType","text","Delimiter","\t","Range",[5,1,1E8,5]); %assume file is never longer than 1E8 rows
+if size(import,2)==5
+    %streamed files interleave the chains in blocks, the stable sort keeps the order inside a chain
+    import=sortrows(import,[1,2,5]);
+end
 
 N_vals=import(1,1);
 T_vals(1,1)=import(1,2);
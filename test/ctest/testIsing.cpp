@@ -4,8 +4,20 @@
 #include <algorithm>
 #include "assert_macro.h"
 #include <chrono>
+#include <climits>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <sstream>
 
+#include "../../Autocorrelation.h"
+#include "../../Resampling.h"
+#include "../../ResultFile.h"
+#include "../../Reweighting.h"
 #include "../../Simulation.h"
+#include "../../SpinLattice2levelPacked.h"
+#include "../../SweepKernels.h"
+#include "../../TsvConverter.h"
 
 int test_SpinLattice2level() {
     int err_code = 0;
@@ -39,9 +51,389 @@ int test_SpinLattice2level() {
         assertEqual (sl1.calcEnergy() >= 0);
     }
 
+    // checkerboard order must reach the same equilibrium
+    SpinLattice2level sl2(64);
+    sl2.sweepOrder = SweepOrder::Checkerboard;
+    sl2.initCold();
+    metropolisSweep(sl2, 1.0, 100);
+    assertEqual (sl2.calcMagnetization() < -0.99);
+    heatBathSweep(sl2, 1.0, 100);
+    assertEqual (sl2.calcMagnetization() < -0.99);
+    heatBathSweep(sl2, 10.0, 100);
+    assertEqual (std::abs(sl2.calcMagnetization()) < 0.2);
+    for (auto &s:sl2.getSpins()) {
+        assertEqual (std::abs(s) == 1);
+    }
+
+    // a strong extern field aligns all spins, for every algorithm
+    SpinLattice2level sl3(32, 4);
+    sl3.initCold();
+    metropolisSweep(sl3, 1.0, 50);
+    assertEqual (sl3.calcMagnetization() > 0.99);
+    sl3.initCold();
+    heatBathSweep(sl3, 1.0, 50);
+    assertEqual (sl3.calcMagnetization() > 0.99);
+    sl3.initCold();
+    sl3.sweepOrder = SweepOrder::Checkerboard;
+    metropolisSweep(sl3, 1.0, 50);
+    assertEqual (sl3.calcMagnetization() > 0.99);
+    sl3.initCold();
+    heatBathSweep(sl3, 1.0, 50);
+    assertEqual (sl3.calcMagnetization() > 0.99);
+
+    return err_code;
+}
+
+int test_SpinLattice2levelPacked() {
+    int err_code = 0;
+
+    // packing and unpacking must keep all spins
+    SpinLattice2level sl0(64);
+    SpinLattice2levelPacked pl0(sl0);
+    assertEqual (pl0.getSights() == 64);
+    assertEqual (pl0.calcEnergy() == sl0.calcEnergy());
+    assertEqual (pl0.calcMagnetization() == sl0.calcMagnetization());
+    const auto unpacked = pl0.unpack();
+    assertEqual (unpacked.getSpins() == sl0.getSpins());
+
+    // ordered at low temperatures
+    SpinLattice2levelPacked pl1(128);
+    pl1.initCold();
+    assertEqual (pl1.calcEnergy() == 0);
+    assertEqual (pl1.calcMagnetization() == -1);
+    metropolisSweep(pl1, 1.0, 200);
+    assertEqual (pl1.calcMagnetization() < -0.99);
+    heatBathSweep(pl1, 1.0, 200);
+    assertEqual (pl1.calcMagnetization() < -0.99);
+    assertEqual (pl1.calcEnergy() == pl1.unpack().calcEnergy());
+
+    // disordered at high temperatures
+    metropolisSweep(pl1, 10.0, 200);
+    assertEqual (std::abs(pl1.calcMagnetization()) < 0.1);
+    heatBathSweep(pl1, 10.0, 200);
+    assertEqual (std::abs(pl1.calcMagnetization()) < 0.1);
+    assertEqual (pl1.calcEnergy() > 0.4);
+    assertEqual (pl1.calcEnergy() == pl1.unpack().calcEnergy());
+
+    return err_code;
+}
+
+int test_Rng() {
+    int err_code = 0;
+
+    // same seed, same stream
+    Xoshiro256ss a(42), b(42);
+    for (int i = 0; i < 100; ++i) {
+        assertEqual (a() == b());
+    }
+    // lane i of the batch generator is the scalar generator after i jumps
+    Xoshiro256ssBatch<8> batch(7);
+    std::uint64_t words[8];
+    batch.next(words);
+    Xoshiro256ss lane(7);
+    for (unsigned int i = 0; i < 8; ++i) {
+        assertEqual (Xoshiro256ss(lane)() == words[i]);
+        lane.jump();
+    }
+    std::vector<float> floats(1001);
+    batch.fill(floats.data(), floats.size());
+    for (auto f:floats) {
+        assertEqual (f >= 0 && f < 1);
+    }
+    assertEqual (std::abs(std::accumulate(floats.begin(), floats.end(), 0.0) / floats.size() - 0.5) < 0.05);
+    for (int i = 0; i < 1000; ++i) {
+        assertEqual (a.bounded(37) < 37);
+        const float f = a.uniformFloat();
+        assertEqual (f >= 0 && f < 1);
+    }
+
+    return err_code;
+}
+
+int test_SweepKernels() {
+    int err_code = 0;
+
+    // every instruction set has to produce exactly the same lattice from the same random numbers
+    const unsigned int seed = 1234;
+    for (unsigned int sights : {6u, 37u, 100u, 256u}) {
+        std::vector<std::vector<short>> results;
+        for (auto isa : {KernelIsa::Scalar, KernelIsa::AVX2, KernelIsa::AVX512}) {
+            setKernelIsa(isa);
+            SpinLattice2level sl(sights, sights % 2);
+            sl.sweepOrder = SweepOrder::Checkerboard;
+            sl.seed(seed);
+            sl.initRandom();
+            metropolisSweep(sl, 2.3, 5);
+            heatBathSweep(sl, 2.3, 5);
+            results.push_back(sl.getSpins());
+        }
+        assertEqual (results[0] == results[1]);
+        assertEqual (results[0] == results[2]);
+    }
+    setKernelIsa(detectKernelIsa());
+    std::cout << "vectorized kernels use " << kernelIsaName(getKernelIsa()) << std::endl;
+
+    return err_code;
+}
+
+/**
+ * @return true if the running totals of sl are the same as a full recalculation
+ */
+bool totalsAreExact(const SpinLattice2level &sl) {
+    SpinLattice2level recalculated(sl);
+    recalculated.recalcTotals();
+    return sl.getBondSum() == recalculated.getBondSum() && sl.getSpinSum() == recalculated.getSpinSum();
+}
+
+int test_runningTotals() {
+    int err_code = 0;
+
+    for (unsigned int sights : {3u, 6u, 37u, 100u}) {
+        for (auto isa : {KernelIsa::Scalar, KernelIsa::AVX2, KernelIsa::AVX512}) {
+            setKernelIsa(isa);
+            for (auto order : {SweepOrder::RowMajor, SweepOrder::Checkerboard}) {
+                SpinLattice2level sl(sights, sights % 2);
+                sl.sweepOrder = order;
+                assertEqual (totalsAreExact(sl));
+                metropolisSweep(sl, 2.3, 3);
+                assertEqual (totalsAreExact(sl));
+                heatBathSweep(sl, 2.3, 3);
+                assertEqual (totalsAreExact(sl));
+                heatBathSweepRandChoice(sl, 2.3);
+                assertEqual (totalsAreExact(sl));
+                wolffSweep(sl, 2.3, 5);
+                assertEqual (totalsAreExact(sl));
+                sl.initCold();
+                assertEqual (sl.getSpinSum() == -1 * static_cast<long long>(sights * sights));
+                assertEqual (sl.calcEnergy() == 0);
+                sl.setSpin(SpinLattice2level::Loc2d(1, 2), 1);
+                assertEqual (totalsAreExact(sl));
+                sl(0, 0) = 1;
+                sl.recalcTotals();
+                assertEqual (totalsAreExact(sl));
+            }
+        }
+    }
+    setKernelIsa(detectKernelIsa());
+
+    return err_code;
+}
+
+int test_WolffEngine() {
+    int err_code = 0;
+
+    // at T -> 0 every parallel neighbour is added: the cluster is the whole cold lattice
+    SpinLattice2level sl(20);
+    sl.seed(8);
+    sl.initCold();
+    wolffSweep(sl, 0.01);
+    assertEqual (sl.wolff.getLastClusterSize() == 400);
+    assertEqual (sl.calcMagnetization() == 1);
+    assertEqual (totalsAreExact(sl));
+    assertEqual (sl.wolff.inLastCluster(0) && sl.wolff.inLastCluster(399));
+
+    // at high temperatures no neighbour is added, only the last cluster is reported
+    for (int i = 0; i < 99; ++i) {
+        wolffSweep(sl, 1e6);
+        assertEqual (sl.wolff.getLastClusterSize() == 1);
+    }
+    const SpinLattice2level beforeLast(sl);
+    wolffSweep(sl, 1e6);
+    unsigned int marked = 0;
+    for (std::uint32_t site = 0; site < 400; ++site) {
+        if (sl.wolff.inLastCluster(site)) {
+            ++marked;
+            assertEqual (sl.getSpins()[site] == -beforeLast.getSpins()[site]);
+        }
+    }
+    assertEqual (marked == 1);
+    assertEqual (totalsAreExact(sl));
+
+    // the cluster consists of flipped spins only
+    SpinLattice2level sl1(37);
+    for (int i = 0; i < 200; ++i) {
+        const SpinLattice2level before(sl1);
+        wolffSweep(sl1, 2.27);
+        unsigned int flipped = 0;
+        for (std::uint32_t site = 0; site < 37 * 37; ++site) {
+            const bool changed = before.getSpins()[site] != sl1.getSpins()[site];
+            flipped += changed;
+            assertEqual (changed == sl1.wolff.inLastCluster(site));
+        }
+        assertEqual (flipped == sl1.wolff.getLastClusterSize());
+    }
+    assertEqual (totalsAreExact(sl1));
+
+    return err_code;
+}
+
+int test_SwendsenWang() {
+    int err_code = 0;
+
+    // the result doesn't depend on the number of threads
+    for (unsigned int sights : {5u, 37u, 64u}) {
+        std::vector<std::vector<short>> results;
+        for (unsigned int threads : {1u, 2u, 3u, 8u}) {
+            SpinLattice2level sl(sights);
+            sl.threads = threads;
+            sl.seed(99);
+            sl.initRandom();
+            swendsenWangSweep(sl, 2.27, 10);
+            assertEqual (totalsAreExact(sl));
+            results.push_back(sl.getSpins());
+        }
+        for (const auto &r : results) {
+            assertEqual (r == results[0]);
+        }
+    }
+
+    // at T -> 0 a cold lattice is one cluster, which is flipped as a whole or not at all
+    SpinLattice2level sl(16);
+    sl.threads = 4;
+    sl.initCold();
+    for (int i = 0; i < 20; ++i) {
+        swendsenWangSweep(sl, 0.01);
+        assertEqual (std::abs(sl.calcMagnetization()) == 1);
+        assertEqual (sl.calcEnergy() == 0);
+    }
+
+    // mean energy at T = 2 like the local algorithms
+    SpinLattice2level sl1(32);
+    sl1.threads = 2;
+    swendsenWangSweep(sl1, 2.0, 100);
+    double energy = 0;
+    for (int i = 0; i < 2000; ++i) {
+        swendsenWangSweep(sl1, 2.0);
+        energy += sl1.calcEnergy();
+    }
+    assertEqual (std::abs(energy / 2000 - 0.0637) < 0.003);
+
     return err_code;
 }
 
+int test_threadedLattice() {
+    int err_code = 0;
+
+    // strips of threads give the same lattice as one thread
+    for (unsigned int sights : {6u, 37u, 100u, 256u}) {
+        std::vector<std::vector<short>> results;
+        for (unsigned int threads : {1u, 2u, 3u, 8u}) {
+            SpinLattice2level sl(sights, sights % 2);
+            sl.sweepOrder = SweepOrder::Checkerboard;
+            sl.threads = threads;
+            sl.seed(5678);
+            sl.initRandom();
+            metropolisSweep(sl, 2.3, 4);
+            heatBathSweep(sl, 2.3);
+            heatBathSweep(sl, 2.3, 3);
+            assertEqual (totalsAreExact(sl));
+            assertEqual (sl.performedSweeps == 8);
+            results.push_back(sl.getSpins());
+        }
+        for (const auto &r : results) {
+            assertEqual (r == results[0]);
+        }
+    }
+
+    // recalcTotals with threads
+    SpinLattice2level sl(50);
+    sl.threads = 7;
+    const long long bondSum = sl.getBondSum();
+    const long long spinSum = sl.getSpinSum();
+    sl.recalcTotals();
+    assertEqual (sl.getBondSum() == bondSum && sl.getSpinSum() == spinSum);
+
+    // the workers are kept between the runs, every strip of a run runs once and waits at the barrier of its run
+    StripWorkers workers;
+    for (unsigned int strips : {3u, 1u, 4u, 4u, 2u, 5u}) {
+        std::vector<std::atomic<int>> runs(strips);
+        std::atomic<unsigned int> arrived(0);
+        bool allArrived = true;
+        workers.run(strips, [&](unsigned int strip, auto &sync) {
+            runs[strip]++;
+            arrived++;
+            sync.arrive_and_wait();
+            if (strip == 0) {
+                allArrived = arrived == strips;
+            }
+        });
+        assertEqual (allArrived);
+        for (const auto &r : runs) {
+            assertEqual (r == 1);
+        }
+    }
+
+    return err_code;
+}
+
+int test_ThreadPool() {
+    int err_code = 0;
+
+    // every task runs exactly once, also when the queues are unbalanced
+    std::vector<std::atomic<int>> runs(200);
+    {
+        ThreadPool pool(4);
+        assertEqual (pool.size() == 4);
+        for (size_t i = 0; i < runs.size(); ++i) {
+            pool.submit([&runs, i]() {
+                if (i % 4 == 0) {// all long tasks in the queue of one worker
+                    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                }
+                runs[i]++;
+            });
+        }
+        pool.wait();
+        for (const auto &r : runs) {
+            assertEqual (r == 1);
+        }
+        // the pool can be used again after wait
+        std::atomic<int> counter(0);
+        for (int i = 0; i < 10; ++i) {
+            pool.submit([&counter]() { counter++; });
+        }
+        assertEqual (pool.waitFor(std::chrono::seconds(10)));
+        assertEqual (counter == 10);
+
+        // a group only waits for its own tasks
+        std::atomic<bool> release(false);
+        pool.submit([&release]() {
+            while (!release) {
+                std::this_thread::yield();
+            }
+        });
+        {
+            TaskGroup group(pool);
+            for (int i = 0; i < 10; ++i) {
+                group.submit([&counter]() { counter++; });
+            }
+            assertEqual (group.waitFor(std::chrono::seconds(10)));
+            assertEqual (counter == 20);
+        }
+        release = true;
+    }
+    // groups nested in tasks of the same pool don't block it, also with a single worker
+    for (const unsigned int threads : {1u, 3u}) {
+        ThreadPool pool(threads);
+        std::atomic<int> inner(0);
+        TaskGroup outer(pool);
+        for (int i = 0; i < 6; ++i) {
+            outer.submit([&pool, &inner]() {
+                TaskGroup nested(pool);
+                for (int j = 0; j < 8; ++j) {
+                    nested.submit([&inner]() { inner++; });
+                }
+                nested.wait();
+            });
+        }
+        assertEqual (outer.waitFor(std::chrono::seconds(10)));
+        assertEqual (inner == 6 * 8);
+    }
+    assertEqual (!sharedPool().isWorker() && !sharedPool().runQueued());
+    assertEqual (sharedPool().size() >= 1);
+    assertEqual (&sharedPool() == &sharedPool());
+
+    return err_code;
+}
 
 int test_Simulation_seq() {
     std::cout << std::endl << "Testing sequential mode" << std::endl << std::endl;
@@ -117,12 +509,1049 @@ int test_Simulation_par() {
     return err_code;
 }
 
+int test_Simulation_reproducible() {
+    std::cout << std::endl << "Testing reproducibility" << std::endl << std::endl;
+    int err_code = 0;
+
+    const std::uint64_t seed = 20211014;
+    const int numOfIterations = 200;
+    Simulation seq(32, 5, 2, 3, numOfIterations, UINT32_MAX);
+    Simulation par(32, 5, 2, 3, numOfIterations, UINT32_MAX);
+    for (auto *Sim : {&seq, &par}) {
+        Sim->seed = seed;
+        Sim->thermalizeSweeps = 20;
+        Sim->printStat = false;
+    }
+    seq.simulate_seq();
+    par.simulate_par();
+    assertEqual (seq.getEnergies() == par.getEnergies());
+    assertEqual (seq.getMagnetization() == par.getMagnetization());
+
+    // one temperature point can be repeated on its own
+    const float temp = seq.getTemps()[3 * numOfIterations];
+    Simulation single(32, 1, temp, temp, numOfIterations, UINT32_MAX);
+    single.seed = seed;
+    single.thermalizeSweeps = 20;
+    single.printStat = false;
+    single.simulate_seq();
+    assertEqual (std::equal(single.getEnergies().begin(), single.getEnergies().end(),
+                            seq.getEnergies().begin() + 3 * numOfIterations));
+
+    // another seed gives other measurements
+    Simulation other(32, 5, 2, 3, numOfIterations, UINT32_MAX);
+    other.seed = seed + 1;
+    other.thermalizeSweeps = 20;
+    other.printStat = false;
+    other.simulate_seq();
+    assertEqual (other.getEnergies() != seq.getEnergies());
+
+    // the sweep order is forwarded to the lattices of every run
+    Simulation rowMajor(32, 3, 2, 3, 50, UINT32_MAX);
+    rowMajor.algorithm = Algorithm::Metropolis;
+    rowMajor.seed = seed;
+    rowMajor.thermalizeSweeps = 5;
+    rowMajor.printStat = false;
+    Simulation checkerboardSeq = rowMajor;
+    checkerboardSeq.sweepOrder = SweepOrder::Checkerboard;
+    Simulation checkerboardPar = checkerboardSeq;
+    rowMajor.simulate_seq();
+    checkerboardSeq.simulate_seq();
+    checkerboardPar.simulate_par();
+    assertEqual (checkerboardSeq.getBondSums() == checkerboardPar.getBondSums());
+    assertEqual (checkerboardSeq.getBondSums() != rowMajor.getBondSums());
+
+    // the threads of every lattice don't change the measurements
+    Simulation striped = checkerboardSeq;
+    striped.threadsPerLattice = 3;
+    Simulation swendsenWang(48, 2, 2, 3, 30, UINT32_MAX);
+    swendsenWang.algorithm = Algorithm::SwendsenWang;
+    swendsenWang.seed = seed;
+    swendsenWang.printStat = false;
+    Simulation swendsenWangStriped = swendsenWang;
+    swendsenWangStriped.threadsPerLattice = 4;
+    striped.simulate_par();
+    swendsenWang.simulate_seq();
+    swendsenWangStriped.simulate_par();
+    assertEqual (striped.getBondSums() == checkerboardSeq.getBondSums());
+    assertEqual (swendsenWangStriped.getBondSums() == swendsenWang.getBondSums());
+
+    // the packed lattice can be chosen for Metropolis and heat-bath
+    Simulation packedSeq(64, 2, 1.5, 3.5, 40, UINT32_MAX);
+    packedSeq.algorithm = Algorithm::HeatBath;
+    packedSeq.latticeType = LatticeType::Packed;
+    packedSeq.seed = seed;
+    packedSeq.thermalizeSweeps = 200;
+    packedSeq.printStat = false;
+    Simulation packedPar = packedSeq;
+    packedSeq.simulate_seq();
+    packedPar.simulate_par();
+    assertEqual (packedSeq.getBondSums() == packedPar.getBondSums());
+    assertEqual (packedSeq.getSpinSums() == packedPar.getSpinSums());
+    const auto packedSummary = packedSeq.getSummary();
+    // ordered (maybe with a few domain walls left) at T=1.5, disordered at T=3.5
+    assertEqual (packedSummary[0].meanEnergy < 0.1 && packedSummary[1].meanEnergy > 0.25);
+    assertEqual (packedSummary[1].meanAbsMagnetization < 0.3);
+    assertEqual (packedSeq.getEnergies()[0] == SpinLattice2level::normalizedEnergy(packedSeq.getBondSums()[0], 1, 64));
+
+    return err_code;
+}
+
+int test_Simulation_chains() {
+    std::cout << std::endl << "Testing chains per temperature" << std::endl << std::endl;
+    int err_code = 0;
+
+    const unsigned int numOfTemps = 3;
+    const unsigned int numOfIterations = 202;
+    const unsigned int numOfChains = 4;
+    std::vector<Simulation> Sims(3, Simulation(16, numOfTemps, 2.2, 2.4, numOfIterations, UINT32_MAX));
+    for (auto &Sim : Sims) {
+        Sim.seed = 99;
+        Sim.thermalizeSweeps = 20;
+        Sim.printStat = false;
+    }
+    Sims[0].chainsPerTemp = numOfChains;
+    Sims[1].chainsPerTemp = numOfChains;
+    Sims[0].simulate_seq();
+    Sims[1].simulate_par();
+    Sims[2].simulate_seq();
+    assertEqual (Sims[0].getEnergies() == Sims[1].getEnergies());
+    assertEqual (Sims[0].getMagnetization() == Sims[1].getMagnetization());
+
+    // the budget is split evenly, the measurements of a chain are consecutive
+    const auto &chains = Sims[0].getChains();
+    assertEqual (chains.size() == numOfTemps * numOfIterations);
+    for (unsigned int t = 0; t < numOfTemps; ++t) {
+        std::vector<unsigned int> length(numOfChains, 0);
+        for (unsigned int i = 0; i < numOfIterations; ++i) {
+            const unsigned int chain = chains[t * numOfIterations + i];
+            assertEqual (chain < numOfChains);
+            assertEqual (i == 0 || chain == chains[t * numOfIterations + i - 1] ||
+                         chain == chains[t * numOfIterations + i - 1] + 1);
+            length[chain]++;
+        }
+        for (const auto l : length) {
+            assertEqual (l == numOfIterations / numOfChains || l == numOfIterations / numOfChains + 1);
+        }
+    }
+    assertEqual (std::all_of(Sims[2].getChains().begin(), Sims[2].getChains().end(),
+                             [](unsigned int chain) { return chain == 0; }));
+
+    // chain 0 is the start of the single chain, the other chains are independent
+    const auto &split = Sims[0].getEnergies();
+    const auto &single = Sims[2].getEnergies();
+    const auto length0 = std::count(chains.begin(), chains.begin() + numOfIterations, 0u);
+    assertEqual (std::equal(split.begin(), split.begin() + length0, single.begin()));
+    assertEqual (!std::equal(split.begin() + length0, split.begin() + numOfIterations, single.begin() + length0));
+
+    return err_code;
+}
+
+int test_Simulation_all() {
+    std::cout << std::endl << "Testing one batch of several simulations" << std::endl << std::endl;
+    int err_code = 0;
+
+    std::vector<Simulation> Sims = {Simulation(8, 3, 2, 3, 100, UINT32_MAX), Simulation(24, 4, 2, 3, 100, 40)};
+    Sims[1].chainsPerTemp = 2;
+    Sims[1].algorithm = Algorithm::Metropolis;
+    Sims[1].priority = 1;
+    for (auto &Sim : Sims) {
+        Sim.seed = 7;
+        Sim.thermalizeSweeps = 20;
+        Sim.printStat = false;
+    }
+    std::vector<Simulation> alone = Sims;
+    Simulation::simulateAll(Sims);
+    for (size_t i = 0; i < Sims.size(); ++i) {
+        alone[i].simulate_seq();
+        assertEqual (Sims[i].getEnergies() == alone[i].getEnergies());
+        assertEqual (Sims[i].getMagnetization() == alone[i].getMagnetization());
+        assertEqual (Sims[i].getChains() == alone[i].getChains());
+    }
+
+    return err_code;
+}
+
+int test_Simulation_status() {
+    std::cout << std::endl << "Testing status and completion" << std::endl << std::endl;
+    int err_code = 0;
+
+    // a short run returns when the workers are finished, not after a status interval
+    Simulation quick(16, 2, 2, 3, 50, UINT32_MAX);
+    quick.printStat = false;
+    const auto begin = std::chrono::steady_clock::now();
+    quick.simulate_par();
+    assertEqual (std::chrono::steady_clock::now() - begin < std::chrono::seconds(5));
+
+    // the status is printed every statusInterval while the simulation runs
+    Simulation Sim(32, 2, 2, 3, 3000, UINT32_MAX);
+    Sim.algorithm = Algorithm::Metropolis;
+    Sim.statusInterval = std::chrono::milliseconds(1);
+    std::stringstream out;
+    auto *cout = std::cout.rdbuf(out.rdbuf());
+    Sim.simulate_seq();
+    std::cout.rdbuf(cout);
+    assertEqual (out.str().find("N=32") != std::string::npos);
+
+    // a copy keeps the progress
+    const Simulation copy = Sim;
+    out.str("");
+    cout = std::cout.rdbuf(out.rdbuf());
+    copy.printStatus();
+    std::cout.rdbuf(cout);
+    assertEqual (out.str().find("run:6000/6000") != std::string::npos);
+
+    return err_code;
+}
+
+int test_autocorrelation() {
+    std::cout << std::endl << "Testing the autocorrelation" << std::endl << std::endl;
+    int err_code = 0;
+
+    // the sums of the definition, with the same normalization per lag
+    auto direct = [](const std::vector<double> &values) {
+        const double mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+        std::vector<double> rho(values.size() / 2);
+        for (size_t t = 0; t < rho.size(); ++t) {
+            double numerator = 0, denominator = 0;
+            for (size_t i = 0; i + t < values.size(); ++i) {
+                numerator += (values[i] - mean) * (values[i + t] - mean);
+                denominator += (values[i] - mean) * (values[i] - mean);
+            }
+            rho[t] = numerator / denominator;
+        }
+        return rho;
+    };
+    Xoshiro256ss rng(17);
+    std::vector<std::vector<double>> series(5);
+    for (size_t s = 0; s < series.size(); ++s) {
+        // odd lengths, one series of another length, AR(1) with rho = 0.8
+        const size_t length = s == 4 ? 301 : 1000 + 3;
+        double x = 0;
+        for (size_t i = 0; i < length; ++i) {
+            x = 0.8 * x + rng.uniformDouble() - 0.5;
+            series[s].push_back(x + static_cast<double>(s));
+        }
+    }
+    const auto batch = autocorrelations(series);
+    assertEqual (batch.size() == series.size());
+    for (size_t s = 0; s < series.size(); ++s) {
+        const auto expected = direct(series[s]);
+        const auto single = autocorrelation(series[s]);
+        assertEqual (single.size() == expected.size() && batch[s].size() == expected.size());
+        double maxError = 0;
+        for (size_t t = 0; t < expected.size(); ++t) {
+            maxError = std::max(maxError, std::abs(single[t] - expected[t]));
+            maxError = std::max(maxError, std::abs(batch[s][t] - expected[t]));
+        }
+        assertEqual (maxError < 1e-10);
+        assertEqual (std::abs(single[0] - 1) < 1e-12 && std::abs(single[1] - 0.8) < 0.1);
+    }
+    // constant series have no correlation, short ones no lags
+    assertEqual (autocorrelation(std::vector<float>(10, 3.0f))[0] == 0);
+    assertEqual (autocorrelation(std::vector<float>(1, 3.0f)).empty());
+
+    // 5E5 measurements
+    std::vector<float> large(500000);
+    for (auto &value : large) {
+        value = static_cast<float>(rng.uniformDouble());
+    }
+    auto begin = std::chrono::steady_clock::now();
+    const auto rho = autocorrelation(large);
+    const auto time = std::chrono::steady_clock::now() - begin;
+    std::cout << "autocorrelation of " << large.size() << " measurements in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(time).count() << "[ms]" << std::endl;
+    assertEqual (rho.size() == large.size() / 2 && std::abs(rho[1]) < 0.01);
+
+    return err_code;
+}
+
+int test_JointHistogram() {
+    std::cout << std::endl << "Testing the joint histograms of bond and spin sums" << std::endl << std::endl;
+    int err_code = 0;
+
+    // dense and sparse give the same entries, sorted and with the parities of the sums
+    JointHistogram dense(6, HistogramStorage::Dense), sparse(6, HistogramStorage::Sparse);
+    assertEqual (JointHistogram(6).isDense() && !JointHistogram(64).isDense());
+    assertEqual (dense.isDense() && !sparse.isDense());
+    Xoshiro256ss rng(5);
+    for (int i = 0; i < 5000; ++i) {
+        const long long bondSum = 2 * static_cast<long long>(rng.uniformDouble() * 73) - 72;
+        const long long spinSum = 2 * static_cast<long long>(rng.uniformDouble() * 37) - 36;
+        dense.add(bondSum, spinSum);
+        sparse.add(bondSum, spinSum);
+    }
+    dense.add(72, 36);
+    sparse.add(72, 36);
+    dense.add(-72, -36, 3);
+    sparse.add(-72, -36, 3);
+    const auto entries = dense.getEntries();
+    const auto sparseEntries = sparse.getEntries();
+    assertEqual (dense.getCount() == 5004 && sparse.getCount() == 5004);
+    assertEqual (entries.size() == sparseEntries.size() && entries.size() == dense.getNumOfBins());
+    std::uint64_t total = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        assertEqual (entries[i].bondSum == sparseEntries[i].bondSum && entries[i].spinSum == sparseEntries[i].spinSum);
+        assertEqual (entries[i].count == sparseEntries[i].count);
+        total += entries[i].count;
+    }
+    assertEqual (total == 5004);
+    assertEqual (entries.front().bondSum == -72 && entries.front().spinSum == -36 && entries.front().count >= 3);
+    assertEqual (entries.back().bondSum == 72 && entries.back().spinSum == 36);
+    // merging mixed storages doubles every count
+    sparse.merge(dense);
+    assertEqual (sparse.getCount() == 2 * 5004 && sparse.getNumOfBins() == entries.size());
+    assertEqual (sparse.getEntries()[7].count == 2 * entries[7].count);
+    // counts beyond 32 bit, e.g. of a bootstrap replica of a long run
+    JointHistogram large(6, HistogramStorage::Dense);
+    large.add(0, 0, 3u << 30);
+    sparse.merge(large, 6);
+    dense.merge(large, 6);
+    assertEqual (sparse.getCount() == 2 * 5004 + (18ull << 30) && dense.getCount() == 5004 + (18ull << 30));
+    assertEqual (sparse.getEntries().size() == dense.getEntries().size());
+
+    // the histograms of a run are the ones of its measurements, merged over the chains
+    Simulation kept(8, 3, 2, 3, 600, UINT32_MAX);
+    kept.chainsPerTemp = 3;
+    kept.seed = 17;
+    kept.printStat = false;
+    kept.collectHistograms = true;
+    Simulation histogramOnly = kept;
+    histogramOnly.keepMeasurements = false;
+    kept.simulate_seq();
+    histogramOnly.simulate_par();
+    assertEqual (Simulation(8, 3, 2, 3, 10, UINT32_MAX).getHistograms().empty());
+    const auto histograms = kept.getHistograms();
+    const auto parallel = histogramOnly.getHistograms();
+    assertEqual (histograms.size() == 3 && parallel.size() == 3);
+    MultiHistogram fromMeasurements(8, 1, 0), fromHistograms(8, 1, 0);
+    for (unsigned int t = 0; t < 3; ++t) {
+        JointHistogram expected(8, HistogramStorage::Sparse);
+        for (size_t i = t * 600; i < (t + 1) * 600; ++i) {
+            expected.add(kept.getBondSums()[i], kept.getSpinSums()[i]);
+        }
+        const auto expectedEntries = expected.getEntries();
+        const auto run = histograms[t].getEntries();
+        const auto runParallel = parallel[t].getEntries();
+        assertEqual (histograms[t].getCount() == 600 && run.size() == expectedEntries.size());
+        assertEqual (runParallel.size() == run.size());
+        for (size_t i = 0; i < run.size(); ++i) {
+            assertEqual (run[i].bondSum == expectedEntries[i].bondSum && run[i].spinSum == expectedEntries[i].spinSum);
+            assertEqual (run[i].count == expectedEntries[i].count && runParallel[i].count == run[i].count);
+        }
+        const auto first = kept.getBondSums().begin() + t * 600;
+        const auto firstSpin = kept.getSpinSums().begin() + t * 600;
+        fromMeasurements.addRun(kept.getTemps()[t * 600], std::vector<long long>(first, first + 600),
+                                std::vector<long long>(firstSpin, firstSpin + 600));
+        fromHistograms.addRun(kept.getTemps()[t * 600], parallel[t]);
+    }
+    // the histograms are all reweighting needs
+    assertEqual (fromMeasurements.solve(2) && fromHistograms.solve(2));
+    const auto reweighted = fromMeasurements.evaluate({2.2f, 2.7f}, 1);
+    const auto fromRun = fromHistograms.evaluate({2.2f, 2.7f}, 1);
+    for (size_t i = 0; i < 2; ++i) {
+        assertEqual (std::abs(reweighted[i].meanEnergy - fromRun[i].meanEnergy) < 1e-12);
+        assertEqual (std::abs(reweighted[i].heatCapacity - fromRun[i].heatCapacity) < 1e-9);
+        assertEqual (std::abs(reweighted[i].binderCumulant - fromRun[i].binderCumulant) < 1e-12);
+    }
+
+    std::stringstream table;
+    kept.writeHistograms(table, true);
+    std::string line;
+    size_t lines = 0;
+    while (std::getline(table, line)) {
+        lines++;
+    }
+    assertEqual (lines == 1 + histograms[0].getNumOfBins() + histograms[1].getNumOfBins() +
+                          histograms[2].getNumOfBins());
+
+    // parallel tempering collects per temperature as well
+    Simulation tempering(8, 3, 2, 3, 100, UINT32_MAX);
+    tempering.printStat = false;
+    tempering.keepMeasurements = false;
+    tempering.collectHistograms = true;
+    tempering.simulate_pt();
+    assertEqual (tempering.getHistograms().size() == 3 && tempering.getHistograms()[2].getCount() == 100);
+
+    return err_code;
+}
+
+int test_BinningAnalysis() {
+    std::cout << std::endl << "Testing the binning analysis" << std::endl << std::endl;
+    int err_code = 0;
+
+    // AR(1) series x_i = rho x_(i-1) + noise has tau = (1 + rho) / (2 (1 - rho))
+    Xoshiro256ss rng(5);
+    const double rho = 0.9;
+    const size_t numOfValues = size_t(1) << 20;
+    BinningAnalysis correlated, uncorrelated;
+    double x = 0;
+    for (size_t i = 0; i < numOfValues; ++i) {
+        const double noise = rng.uniformDouble() - 0.5;
+        x = rho * x + noise;
+        correlated.add(x);
+        uncorrelated.add(noise);
+    }
+    // one level per factor 2
+    assertEqual (correlated.getLevels().size() == 21);
+    assertEqual (correlated.getLevels()[20].getCount() == 1);
+    const auto result = correlated.getResult();
+    assertEqual (result.converged);
+    assertEqual (std::abs(result.tau - 9.5) < 0.1 * 9.5);
+    assertEqual (std::abs(result.effectiveSamples - numOfValues / (2 * result.tau)) < 1e-6);
+    const auto moments = correlated.getMoments();
+    assertEqual (std::abs(result.error - std::sqrt(moments.getVariance() / numOfValues * 2 * result.tau)) < 1e-12);
+    const auto independent = uncorrelated.getResult();
+    assertEqual (independent.converged && independent.tau < 0.6);
+
+    // pooled bins of two halves give about the same estimate
+    BinningAnalysis firstHalf, secondHalf;
+    x = 0;
+    for (size_t i = 0; i < numOfValues; ++i) {
+        x = rho * x + rng.uniformDouble() - 0.5;
+        (i < numOfValues / 2 ? firstHalf : secondHalf).add(x);
+    }
+    firstHalf.merge(secondHalf);
+    assertEqual (firstHalf.getMoments().getCount() == numOfValues);
+    assertEqual (std::abs(firstHalf.getResult().tau - 9.5) < 0.1 * 9.5);
+
+    // too short to see the plateau
+    BinningAnalysis shortSeries;
+    for (int i = 0; i < 40; ++i) {
+        shortSeries.add(i);
+    }
+    assertEqual (!shortSeries.getResult().converged && shortSeries.getResult().level == 0);
+
+    // a local algorithm close to T_c decorrelates slowly
+    Simulation Sim(16, 1, 2.3, 2.3, 1 << 14, UINT32_MAX);
+    Sim.algorithm = Algorithm::Metropolis;
+    Sim.seed = 8;
+    Sim.printStat = false;
+    Sim.keepMeasurements = false;
+    Sim.simulate_seq();
+    const auto &energy = Sim.getSummary()[0].energyBinning;
+    assertEqual (energy.tau > 2 && energy.effectiveSamples < (1 << 14) / 4.0);
+    assertEqual (energy.error > 0 && energy.level > 0);
+
+    return err_code;
+}
+
+int test_Simulation_summary() {
+    std::cout << std::endl << "Testing the moments accumulated in a run" << std::endl << std::endl;
+    int err_code = 0;
+
+    // merging the moments of two parts gives the moments of the whole series
+    RunningMoments whole, first, second;
+    for (int i = 0; i < 1000; ++i) {
+        const double value = 1e6 + std::sin(i) * 1e-3;
+        whole.add(value);
+        (i < 300 ? first : second).add(value);
+    }
+    first.merge(second);
+    assertEqual (first.getCount() == 1000);
+    assertEqual (std::abs(first.getMean() - whole.getMean()) < 1e-14 * whole.getMean());
+    // the variance is 1e-18 of the squares, a sum of the squares would lose it completely
+    assertEqual (std::abs(first.getVariance() - 5e-7) < 1e-4 * 5e-7);
+    assertEqual (std::abs(first.getVariance() - whole.getVariance()) < 1e-6 * whole.getVariance());
+
+    Simulation kept(12, 3, 2, 3, 400, UINT32_MAX);
+    kept.chainsPerTemp = 3;
+    kept.seed = 99;
+    kept.thermalizeSweeps = 20;
+    kept.printStat = false;
+    Simulation summaryOnly = kept;
+    summaryOnly.keepMeasurements = false;
+    kept.simulate_seq();
+    summaryOnly.simulate_par();
+    assertEqual (summaryOnly.getEnergies().empty() && summaryOnly.getBondSums().empty());
+
+    // the same as two passes over the kept measurements
+    const auto summary = kept.getSummary();
+    assertEqual (summary.size() == 3);
+    const double numOfSpins = 12 * 12;
+    for (unsigned int t = 0; t < 3; ++t) {
+        const size_t begin = t * 400;
+        double e = 0, absM = 0, m2 = 0, m4 = 0;
+        for (size_t i = begin; i < begin + 400; ++i) {
+            const double m = static_cast<double>(kept.getSpinSums()[i]) / numOfSpins;
+            e += 0.5 - static_cast<double>(kept.getBondSums()[i]) / (4 * numOfSpins);
+            absM += std::abs(m);
+            m2 += m * m;
+            m4 += m * m * m * m;
+        }
+        e /= 400, absM /= 400, m2 /= 400, m4 /= 400;
+        double varE = 0, varM = 0;
+        for (size_t i = begin; i < begin + 400; ++i) {
+            const double m = static_cast<double>(kept.getSpinSums()[i]) / numOfSpins;
+            const double energy = 0.5 - static_cast<double>(kept.getBondSums()[i]) / (4 * numOfSpins);
+            varE += (energy - e) * (energy - e) / 399;
+            varM += (std::abs(m) - absM) * (std::abs(m) - absM) / 399;
+        }
+        const auto &row = summary[t];
+        const double temp = kept.getTemps()[begin];
+        assertEqual (row.count == 400 && row.temp == kept.getTemps()[begin]);
+        assertEqual (std::abs(row.meanEnergy - e) < 1e-12 && std::abs(row.meanAbsMagnetization - absM) < 1e-12);
+        assertEqual (std::abs(row.meanMagnetizationSquared - m2) < 1e-12);
+        assertEqual (std::abs(row.meanMagnetizationFourth - m4) < 1e-12);
+        assertEqual (std::abs(row.heatCapacity - numOfSpins * varE / (temp * temp)) < 1e-9 * row.heatCapacity);
+        assertEqual (std::abs(row.susceptibility - numOfSpins * varM / temp) < 1e-9 * row.susceptibility);
+        assertEqual (std::abs(row.binderCumulant - (1 - m4 / (3 * m2 * m2))) < 1e-9);
+        assertEqual (row.binderCumulant > 0 && row.binderCumulant < 2.0 / 3 + 1e-12);
+    }
+    // the chains are merged in their order, without the measurements and in parallel
+    const auto withoutMeasurements = summaryOnly.getSummary();
+    for (unsigned int t = 0; t < 3; ++t) {
+        assertEqual (withoutMeasurements[t].meanEnergy == summary[t].meanEnergy);
+        assertEqual (withoutMeasurements[t].heatCapacity == summary[t].heatCapacity);
+        assertEqual (withoutMeasurements[t].binderCumulant == summary[t].binderCumulant);
+    }
+    // ordered: the magnetization falls with the temperature
+    assertEqual (summary[0].meanAbsMagnetization > summary[2].meanAbsMagnetization);
+
+    std::stringstream table;
+    kept.writeSummary(table, true);
+    std::string line;
+    int lines = 0;
+    while (std::getline(table, line)) {
+        lines++;
+    }
+    assertEqual (lines == 1 + 3);
+
+    // parallel tempering accumulates per temperature as well
+    Simulation tempering(8, 3, 2, 3, 100, UINT32_MAX);
+    tempering.algorithm = Algorithm::Metropolis;
+    tempering.printStat = false;
+    tempering.keepMeasurements = false;
+    tempering.simulate_pt();
+    assertEqual (tempering.getEnergies().empty() && tempering.getSummary().size() == 3);
+    assertEqual (tempering.getSummary()[1].count == 100);
+
+    return err_code;
+}
+
+int test_MultiHistogram() {
+    std::cout << std::endl << "Testing the multi-histogram reweighting" << std::endl << std::endl;
+    int err_code = 0;
+
+    // one run reweighted to its own temperature gives its own means
+    Simulation single(8, 1, 2.5, 2.5, 3000, UINT32_MAX);
+    single.seed = 21;
+    single.printStat = false;
+    single.simulate_seq();
+    MultiHistogram alone(8, 1, 0);
+    alone.addRun(2.5, single.getBondSums(), single.getSpinSums());
+    assertEqual (alone.solve(1));
+    const auto own = alone.evaluate({2.5f}, 1)[0];
+    const auto summary = single.getSummary()[0];
+    assertEqual (std::abs(own.meanEnergy - summary.meanEnergy) < 1e-12);
+    assertEqual (std::abs(own.meanAbsMagnetization - summary.meanAbsMagnetization) < 1e-12);
+    assertEqual (std::abs(own.binderCumulant - summary.binderCumulant) < 1e-10);
+    // a run without measurements changes nothing, without any measurement solve fails instead of giving NaN
+    MultiHistogram withEmpty(8, 1, 0);
+    withEmpty.addRun(2.5, single.getBondSums(), single.getSpinSums());
+    withEmpty.addRun(2.7, {}, {});
+    assertEqual (withEmpty.solve(1));
+    assertEqual (std::isfinite(withEmpty.getFreeEnergies()[1]));
+    assertEqual (std::abs(withEmpty.evaluate({2.5f}, 1)[0].meanEnergy - own.meanEnergy) < 1e-12);
+    MultiHistogram empty(8, 1, 0);
+    empty.addRun(2.5, {}, {});
+    empty.addRun(2.7, JointHistogram(8));
+    assertEqual (!empty.solve(2));
+    assertEqual (empty.getFreeEnergies()[0] == 0 && empty.getFreeEnergies()[1] == 0);
+    // population instead of sample variance
+    assertEqual (std::abs(own.heatCapacity - summary.heatCapacity * 2999 / 3000) < 1e-9 * own.heatCapacity);
+
+    // exact moments of the 4x4 lattice with periodic boundaries, from all 2^16 states
+    const unsigned int sights = 4;
+    const float temp = 2.3f;
+    double z = 0, energy = 0, energySquared = 0, absM = 0;
+    for (unsigned int state = 0; state < (1u << 16); ++state) {
+        auto spin = [state](unsigned int x, unsigned int y) {
+            return (state >> ((y % sights) * sights + x % sights)) & 1 ? 1 : -1;
+        };
+        long long bondSum = 0, spinSum = 0;
+        for (unsigned int y = 0; y < sights; ++y) {
+            for (unsigned int x = 0; x < sights; ++x) {
+                bondSum += spin(x, y) * (spin(x + 1, y) + spin(x, y + 1));
+                spinSum += spin(x, y);
+            }
+        }
+        const double weight = std::exp(static_cast<double>(bondSum) / temp);
+        const double e = 0.5 - static_cast<double>(bondSum) / (4 * 16);
+        z += weight;
+        energy += weight * e;
+        energySquared += weight * e * e;
+        absM += weight * std::abs(static_cast<double>(spinSum)) / 16;
+    }
+    energy /= z, energySquared /= z, absM /= z;
+    const double heatCapacity = 16 * (energySquared - energy * energy) / (temp * temp);
+
+    Simulation runs(sights, 5, 2, 3, 20000, UINT32_MAX);
+    runs.seed = 22;
+    runs.printStat = false;
+    runs.simulate_seq();
+    MultiHistogram histogram(sights, 1, 0);
+    for (unsigned int t = 0; t < 5; ++t) {
+        const auto first = runs.getBondSums().begin() + t * 20000;
+        const auto firstSpin = runs.getSpinSums().begin() + t * 20000;
+        histogram.addRun(runs.getTemps()[t * 20000], std::vector<long long>(first, first + 20000),
+                         std::vector<long long>(firstSpin, firstSpin + 20000));
+    }
+    assertEqual (histogram.solve(1));
+    const auto freeEnergies = histogram.getFreeEnergies();
+    assertEqual (freeEnergies.size() == 5 && freeEnergies[0] == 0);
+    // between the runs at 2.25 and 2.5
+    const auto reweighted = histogram.evaluate({2.0f, temp, 3.0f}, 2);
+    assertEqual (std::abs(reweighted[1].meanEnergy - energy) < 0.01 * energy);
+    assertEqual (std::abs(reweighted[1].meanAbsMagnetization - absM) < 0.01 * absM);
+    assertEqual (std::abs(reweighted[1].heatCapacity - heatCapacity) < 0.05 * heatCapacity);
+    assertEqual (reweighted[0].meanEnergy < reweighted[1].meanEnergy);
+    assertEqual (reweighted[1].meanEnergy < reweighted[2].meanEnergy);
+
+    // the strips of the energies only change the rounding
+    assertEqual (histogram.solve(3));
+    for (unsigned int t = 0; t < 5; ++t) {
+        assertEqual (std::abs(histogram.getFreeEnergies()[t] - freeEnergies[t]) < 1e-8);
+    }
+    assertEqual (std::abs(histogram.evaluate({temp}, 1)[0].heatCapacity - reweighted[1].heatCapacity) < 1e-8);
+
+    return err_code;
+}
+
+int test_Resampling() {
+    std::cout << std::endl << "Testing the jackknife and bootstrap errors" << std::endl << std::endl;
+    int err_code = 0;
+
+    // the jackknife error of a mean is the standard error of the bin means
+    std::vector<double> values(64);
+    Xoshiro256ss rng(8);
+    for (auto &value : values) {
+        value = rng.uniformDouble();
+    }
+    const auto mean = [&values](const Multiplicities &weights) {
+        double sum = 0, count = 0;
+        for (size_t i = 0; i < values.size(); ++i) {
+            sum += weights[0][i] * values[i];
+            count += weights[0][i];
+        }
+        return std::vector<double>{sum / count};
+    };
+    const double average = std::accumulate(values.begin(), values.end(), 0.0) / 64;
+    double squares = 0;
+    for (const double value : values) {
+        squares += (value - average) * (value - average);
+    }
+    const double standardError = std::sqrt(squares / 63 / 64);
+    const Resampler single({64});
+    const auto jack = single.jackknife(mean);
+    assertEqual (std::abs(jack.estimate[0] - average) < 1e-14);
+    assertEqual (std::abs(jack.error[0] - standardError) < 1e-12);
+    assertEqual (std::abs(jack.bias[0]) < 1e-12);
+    const auto boot = single.bootstrap(mean, 4000, 3);
+    assertEqual (std::abs(boot.error[0] - standardError) < 0.1 * standardError);
+    assertEqual (std::abs(boot.bias[0]) < 0.2 * standardError);
+    // every replica has its own stream, the threads don't matter
+    ThreadPool one(1);
+    const auto sequential = Resampler({64}, one).bootstrap(mean, 4000, 3);
+    assertEqual (sequential.error[0] == boot.error[0] && sequential.replicaMean[0] == boot.replicaMean[0]);
+    // an estimator may use the pool itself, e.g. through autocorrelations of the weighted bins
+    const auto firstLag = [&values](const Multiplicities &weights) {
+        std::vector<std::vector<double>> series(2, values);
+        for (size_t i = 0; i < values.size(); ++i) {
+            series[1][i] *= weights[0][i];
+        }
+        const auto rho = autocorrelations(series);
+        return std::vector<double>{rho[0][1], rho[1][1]};
+    };
+    const auto nested = single.bootstrap(firstLag, 64, 3);
+    assertEqual (std::abs(nested.estimate[0] - autocorrelation(values)[1]) < 1e-12);
+    assertEqual (std::abs(nested.estimate[1] - nested.estimate[0]) < 1e-12);
+    assertEqual (nested.error[0] < 1e-12 && nested.error[1] > 1e-3);
+
+    // the binned observables of the whole data are the ones of the measurements
+    Simulation S(8, 3, 2.1, 2.7, 2000, UINT32_MAX);
+    S.seed = 12;
+    S.printStat = false;
+    S.simulate_seq();
+    std::vector<ObservableBins> temperatures;
+    std::vector<size_t> binsPerSet;
+    for (unsigned int t = 0; t < 3; ++t) {
+        const auto first = S.getBondSums().begin() + t * 2000;
+        const auto firstSpin = S.getSpinSums().begin() + t * 2000;
+        temperatures.emplace_back(8, S.getTemps()[t * 2000], 1, std::vector<long long>(first, first + 2000),
+                                  std::vector<long long>(firstSpin, firstSpin + 2000), 40, true);
+        binsPerSet.push_back(temperatures.back().getNumOfBins());
+    }
+    assertEqual (binsPerSet[0] == 40);
+    const auto summary = S.getSummary();
+    const Resampler grid(binsPerSet);
+    const auto whole = grid.wholeData();
+    for (unsigned int t = 0; t < 3; ++t) {
+        const auto point = temperatures[t].observables(whole[t]);
+        assertEqual (std::abs(point.meanEnergy - summary[t].meanEnergy) < 1e-12);
+        assertEqual (std::abs(point.binderCumulant - summary[t].binderCumulant) < 1e-10);
+        assertEqual (std::abs(point.heatCapacity - summary[t].heatCapacity * 1999 / 2000) < 1e-9 * point.heatCapacity);
+        assertEqual (temperatures[t].histogram(whole[t]).getCount() == 2000);
+    }
+
+    // heat capacity of every temperature, the errors are about the ones of the binning of the measurements
+    const auto heatCapacities = [&temperatures](const Multiplicities &weights) {
+        std::vector<double> result;
+        for (size_t t = 0; t < temperatures.size(); ++t) {
+            result.push_back(temperatures[t].observables(weights[t]).heatCapacity);
+        }
+        return result;
+    };
+    const auto jackGrid = grid.jackknife(heatCapacities);
+    const auto bootGrid = grid.bootstrap(heatCapacities, 2000, 5);
+    for (unsigned int t = 0; t < 3; ++t) {
+        assertEqual (jackGrid.error[t] > 0 && jackGrid.error[t] < 0.5 * jackGrid.estimate[t]);
+        assertEqual (std::abs(bootGrid.error[t] - jackGrid.error[t]) < 0.3 * jackGrid.error[t]);
+    }
+
+    // the temperature of the maximum of the reweighted heat capacity, all temperatures resampled at once
+    std::vector<float> fineGrid(601);
+    for (size_t i = 0; i < fineGrid.size(); ++i) {
+        fineGrid[i] = 2.1f + 0.001f * static_cast<float>(i);
+    }
+    const auto peak = [&temperatures, &fineGrid](const Multiplicities &weights) {
+        MultiHistogram histogram(8, 1, 0);
+        for (size_t t = 0; t < temperatures.size(); ++t) {
+            histogram.addRun(temperatures[t].getTemp(), temperatures[t].histogram(weights[t]));
+        }
+        histogram.solve(1);
+        const auto points = histogram.evaluate(fineGrid, 1);
+        const auto maximum = std::max_element(points.begin(), points.end(), [](const auto &a, const auto &b) {
+            return a.heatCapacity < b.heatCapacity;
+        });
+        return std::vector<double>{maximum->temp};
+    };
+    const auto peakError = grid.jackknife(peak);
+    assertEqual (peakError.estimate[0] > 2.2 && peakError.estimate[0] < 2.7);
+    assertEqual (peakError.error[0] > 0 && peakError.error[0] < 0.2);
+
+    return err_code;
+}
+
+int test_MeasurementWriter() {
+    std::cout << std::endl << "Testing streamed measurements" << std::endl << std::endl;
+    int err_code = 0;
+
+    const std::string path = (std::filesystem::temp_directory_path() / "testIsingMeasurements.tsv").string();
+    const unsigned int numOfIterations = 101;
+    Simulation kept(16, 3, 2, 3, numOfIterations, 30);
+    kept.chainsPerTemp = 2;
+    kept.seed = 5;
+    kept.thermalizeSweeps = 20;
+    kept.printStat = false;
+    Simulation streamed = kept;
+    {
+        // small buffers, so the chains have to wait for the writer
+        MeasurementWriter writer(path, ResultFormat::Tsv, "N\ttemp\tmagnetization\tenergy\tchain\tbondSum\tspinSum\n",
+                                 7);
+        streamed.writer = &writer;
+        streamed.simulate_par();
+        writer.close();
+        assertEqual (writer.getWrittenRows() == 3 * numOfIterations);
+    }
+    kept.simulate_seq();
+    assertEqual (streamed.getEnergies().empty());
+
+    // every chain is in order, so the stable sort gives the order of the measurements in memory
+    struct Row {
+        float temp, magnetization, energy;
+        unsigned int chain;
+        long long bondSum, spinSum;
+    };
+    std::vector<Row> rows;
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    assertEqual (line == "N\ttemp\tmagnetization\tenergy\tchain\tbondSum\tspinSum");
+    unsigned int sights;
+    Row row{};
+    while (file >> sights >> row.temp >> row.magnetization >> row.energy >> row.chain >> row.bondSum >> row.spinSum) {
+        assertEqual (sights == 16);
+        rows.push_back(row);
+    }
+    std::filesystem::remove(path);
+    assertEqual (rows.size() == kept.getEnergies().size());
+    std::stable_sort(rows.begin(), rows.end(), [](const Row &a, const Row &b) {
+        return a.temp != b.temp ? a.temp < b.temp : a.chain < b.chain;
+    });
+    for (size_t i = 0; i < rows.size(); ++i) {
+        assertEqual (std::abs(rows[i].temp - kept.getTemps()[i]) < 1E-6);
+        assertEqual (std::abs(rows[i].energy - kept.getEnergies()[i]) < 1E-6);
+        assertEqual (std::abs(rows[i].magnetization - kept.getMagnetization()[i]) < 1E-6);
+        assertEqual (rows[i].chain == kept.getChains()[i]);
+        assertEqual (rows[i].bondSum == kept.getBondSums()[i] && rows[i].spinSum == kept.getSpinSums()[i]);
+    }
+
+    return err_code;
+}
+
+int test_ResultFile() {
+    std::cout << std::endl << "Testing binary result files" << std::endl << std::endl;
+    int err_code = 0;
+
+    const std::string path = (std::filesystem::temp_directory_path() / "testIsingResults.bin").string();
+    std::vector<Simulation> kept = {Simulation(16, 3, 2, 3, 101, UINT32_MAX), Simulation(8, 2, 2.5, 3, 50, 20)};
+    kept[0].chainsPerTemp = 2;
+    kept[1].algorithm = Algorithm::HeatBath;
+    for (auto &Sim : kept) {
+        Sim.seed = 11;
+        Sim.thermalizeSweeps = 20;
+        Sim.printStat = false;
+    }
+    std::vector<Simulation> streamed = kept;
+    // parallel tempering writes one channel per temperature, in the same file
+    Simulation tempering(12, 4, 2, 3, 60, UINT32_MAX);
+    tempering.algorithm = Algorithm::Metropolis;
+    tempering.seed = 3;
+    tempering.printStat = false;
+    Simulation temperingKept = tempering;
+    {
+        MeasurementWriter writer(path, ResultFormat::Binary, "", 16, std::chrono::milliseconds(1));
+        for (auto &Sim : streamed) {
+            Sim.writer = &writer;
+        }
+        tempering.writer = &writer;
+        Simulation::simulateAll(streamed);
+        tempering.simulate_pt();
+        writer.close();
+        assertEqual (writer.getWrittenRows() == 3 * 101 + 2 * 50 + 4 * 60);
+    }
+    for (auto &Sim : kept) {
+        Sim.simulate_seq();
+    }
+    temperingKept.simulate_pt();
+    kept.push_back(temperingKept);
+
+    // every block is read in place and has the measurements in the order of the memory
+    const ResultFile file(path);
+    assertEqual (file.getNumOfBlocks() == 3 + 2 + 4);
+    for (const auto &Sim : kept) {
+        for (unsigned int t = 0; t < Sim.getNumOfTemps(); ++t) {
+            const size_t first = static_cast<size_t>(t) * Sim.getNumOfIterations();
+            const size_t block = file.findBlock(Sim.getSights(), Sim.getTemps()[first]);
+            assertEqual (block < file.getNumOfBlocks());
+            const ResultBlock &info = file.getBlock(block);
+            assertEqual (info.count == Sim.getNumOfIterations() && info.written == info.count);
+            assertEqual (info.seed == Sim.getSeed());
+            assertEqual (info.algorithm == static_cast<std::uint32_t>(Sim.algorithm));
+            assertEqual (info.chains == *std::max_element(Sim.getChains().begin(), Sim.getChains().end()) + 1);
+            // the exact sums and the same floats as in memory
+            const auto bondSums = file.getBondSums(block);
+            const auto spinSums = file.getSpinSums(block);
+            const auto energies = file.getEnergies(block);
+            const auto magnetization = file.getMagnetization(block);
+            const auto begin = static_cast<long>(first);
+            assertEqual (std::equal(bondSums.begin(), bondSums.end(), Sim.getBondSums().begin() + begin));
+            assertEqual (std::equal(spinSums.begin(), spinSums.end(), Sim.getSpinSums().begin() + begin));
+            assertEqual (std::equal(energies.begin(), energies.end(), Sim.getEnergies().begin() + begin));
+            assertEqual (std::equal(magnetization.begin(), magnetization.end(),
+                                    Sim.getMagnetization().begin() + begin));
+        }
+    }
+    std::filesystem::remove(path);
+
+    // a crashed run: the chunks written after the last index are found, also the ones of blocks not indexed yet
+    const std::string crashed = path + ".crashed";
+    {
+        MeasurementWriter writer(path, ResultFormat::Binary, "", 16, std::chrono::minutes(10));
+        ResultBlock info{};
+        info.sights = 8;
+        info.temp = 2.5;
+        info.count = 1000;
+        info.J = 1;
+        info.seed = 4;
+        const unsigned int first = writer.addBlock(info);
+        info.temp = 3;
+        const unsigned int second = writer.addBlock(info);
+        {
+            MeasurementWriter::Channel channel(writer, first, 0, 0);
+            MeasurementWriter::Channel other(writer, second, 0, 10);
+            for (long long i = 0; i < 990; ++i) {
+                channel.push(2 * i - 64, i % 2 == 0 ? 64 : -64);
+            }
+            other.push(4, 2);
+        }
+        // the last buffers are written, the only index is the empty one of the start
+        std::filesystem::copy_file(path, crashed, std::filesystem::copy_options::overwrite_existing);
+        writer.close();
+    }
+    {
+        const ResultFile recovered(crashed);
+        assertEqual (recovered.getNumOfBlocks() == 2);
+        const ResultBlock &info = recovered.getBlock(0);
+        assertEqual (info.sights == 8 && info.temp == 2.5f && info.seed == 4 && info.count == 1000);
+        assertEqual (info.written == 990 && recovered.getBlock(1).written == 1);
+        const auto bondSums = recovered.getBondSums(0);
+        const auto spinSums = recovered.getSpinSums(0);
+        assertEqual (bondSums[989] == 2 * 989 - 64 && spinSums[989] == -64 && bondSums[990] == 0);
+        assertEqual (recovered.getBondSums(1)[10] == 4 && recovered.getSpinSums(1)[10] == 2);
+        // the closed file has the same measurements in its index
+        const ResultFile closed(path);
+        assertEqual (closed.getNumOfBlocks() == 2 && closed.getBondSums(0) == bondSums);
+    }
+    std::filesystem::remove(crashed);
+    std::filesystem::remove(path);
+
+    // the deltas of successive measurements are small, also the extremes survive
+    const std::vector<long long> values = {0, 1, -1, 300, 299, -70000, LLONG_MAX, LLONG_MIN, LLONG_MIN, 5};
+    std::vector<unsigned char> bytes;
+    const size_t numOfBytes = encodeDeltas(values.data(), values.size(), bytes);
+    assertEqual (numOfBytes == bytes.size());
+    std::vector<long long> decoded(values.size());
+    assertEqual (decodeDeltas(bytes.data(), bytes.size(), values.size(), decoded.data()) == bytes.size());
+    assertEqual (decoded == values);
+    assertEqual (decodeDeltas(bytes.data(), bytes.size() - 1, values.size(), decoded.data()) == 0);
+    bytes.clear();
+    const auto &bondSums = kept[0].getBondSums();
+    encodeDeltas(bondSums.data(), bondSums.size(), bytes);
+    assertEqual (bytes.size() < 2 * bondSums.size());
+
+    return err_code;
+}
+
+int test_TsvConverter() {
+    std::cout << std::endl << "Testing the conversion of TSV result files" << std::endl << std::endl;
+    int err_code = 0;
+
+    // odd N: the spin sum is odd
+    std::vector<Simulation> Sims = {Simulation(15, 3, 2, 3, 301, UINT32_MAX), Simulation(8, 2, 2.5, 3, 200, 20)};
+    for (auto &Sim : Sims) {
+        Sim.seed = 77;
+        Sim.printStat = false;
+        Sim.simulate_seq();
+    }
+    // the format of the old ising-headless
+    const auto directory = std::filesystem::temp_directory_path();
+    const std::string tsvPath = (directory / "testIsingLegacy.tsv").string();
+    const std::string binaryPath = (directory / "testIsingLegacy.bin").string();
+    {
+        std::ofstream file(tsvPath);
+        file << "numOfTemps:\t3\nnumOfIterations:\t301\nseed:\t77\n\n";
+        file << "N\ttemp\tmagnetization\tenergy\tsusceptibility\theatCapacity\n";
+        file << std::fixed;
+        for (const auto &Sim : Sims) {
+            for (size_t i = 0; i < Sim.getEnergies().size(); ++i) {
+                file << Sim.getSights() << "\t" << Sim.getTemps()[i] << "\t"
+                     << Sim.getMagnetization()[i] << "\t" << Sim.getEnergies()[i] << "\n";
+            }
+        }
+    }
+
+    for (unsigned int threads : {1u, 3u}) {
+        const auto stats = convertTsv(tsvPath, binaryPath, threads);
+        const ResultFile file(binaryPath);
+        assertEqual (stats.size() == 3 + 2 && file.getNumOfBlocks() == stats.size());
+        size_t block = 0;
+        for (const auto &Sim : Sims) {
+            const size_t numOfIterations = Sim.getNumOfIterations();
+            for (unsigned int t = 0; t < Sim.getNumOfTemps(); ++t, ++block) {
+                // the blocks in the order of the file, with the exact sums
+                const auto first = static_cast<long>(t * numOfIterations);
+                const ResultBlock &info = file.getBlock(block);
+                assertEqual (info.sights == Sim.getSights() && info.count == numOfIterations && info.seed == 77);
+                // a TSV file doesn't tell how it was simulated
+                assertEqual (info.algorithm == resultUnknown && info.sweepsPerIteration == resultUnknown &&
+                             info.thermalizeSweeps == resultUnknown);
+                assertEqual (std::abs(info.temp - Sim.getTemps()[first]) < 1e-6);
+                const auto bondSums = file.getBondSums(block);
+                const auto spinSums = file.getSpinSums(block);
+                assertEqual (std::equal(bondSums.begin(), bondSums.end(), Sim.getBondSums().begin() + first));
+                assertEqual (std::equal(spinSums.begin(), spinSums.end(), Sim.getSpinSums().begin() + first));
+
+                const auto &blockStats = stats[block];
+                assertEqual (blockStats.count == numOfIterations && blockStats.inexact == 0);
+                const auto energies = file.getEnergies(block);
+                const double meanEnergy = std::accumulate(energies.begin(), energies.end(), 0.0) / numOfIterations;
+                double varEnergy = 0;
+                for (float energy : energies) {
+                    varEnergy += (energy - meanEnergy) * (energy - meanEnergy) / (numOfIterations - 1);
+                }
+                assertEqual (std::abs(blockStats.meanEnergy - meanEnergy) < 1e-6);
+                assertEqual (std::abs(blockStats.varEnergy - varEnergy) < 1e-6 * varEnergy);
+                const auto magnetization = file.getMagnetization(block);
+                const double meanAbs = std::accumulate(magnetization.begin(), magnetization.end(), 0.0,
+                                                       [](double sum, float m) { return sum + std::abs(m); });
+                assertEqual (std::abs(blockStats.meanAbsMagnetization - meanAbs / numOfIterations) < 1e-6);
+            }
+        }
+    }
+    std::filesystem::remove(tsvPath);
+    std::filesystem::remove(binaryPath);
+
+    return err_code;
+}
+
+int test_Simulation_pt() {
+    std::cout << std::endl << "Testing parallel tempering" << std::endl << std::endl;
+    int err_code = 0;
+
+    const unsigned int numOfTemps = 6;
+    const unsigned int numOfIterations = 2000;
+    std::vector<std::vector<float>> energies;
+    for (int run = 0; run < 2; ++run) {
+        Simulation Sim(16, numOfTemps, 2.0, 2.6, numOfIterations, UINT32_MAX);
+        Sim.seed = 4242;
+        Sim.algorithm = Algorithm::Metropolis;
+        Sim.thermalizeSweeps = 200;
+        Sim.printStat = false;
+        Sim.simulate_pt();
+        assertEqual (Sim.getEnergies().size() == numOfTemps * numOfIterations);
+        assertEqual (Sim.getMagnetization().size() == numOfTemps * numOfIterations);
+        const auto acceptance = Sim.getSwapAcceptance();
+        assertEqual (acceptance.size() == numOfTemps - 1);
+        for (unsigned int t = 0; t + 1 < numOfTemps; ++t) {
+            assertEqual (acceptance[t] > 0.05 && acceptance[t] <= 1);
+            // even and odd pairs alternate
+            assertEqual (Sim.getSwapAttempts()[t] == numOfIterations / 2);
+        }
+        // the energy rises with the temperature
+        std::vector<double> meanEnergy(numOfTemps);
+        for (unsigned int t = 0; t < numOfTemps; ++t) {
+            const auto first = Sim.getEnergies().begin() + t * numOfIterations;
+            meanEnergy[t] = std::accumulate(first, first + numOfIterations, 0.0) / numOfIterations;
+            assertEqual (std::abs(Sim.getTemps()[t * numOfIterations] - (2.0f + static_cast<float>(t) * 0.12f)) < 1e-5);
+        }
+        assertEqual (std::is_sorted(meanEnergy.begin(), meanEnergy.end()));
+        energies.push_back(Sim.getEnergies());
+    }
+    // the same seed gives the same run, independent of the scheduling of the threads
+    assertEqual (energies[0] == energies[1]);
+
+    return err_code;
+}
+
 int main() {
     int err_code = 0;
     auto begin = std::chrono::steady_clock::now();
     assertEqual (test_SpinLattice2level() == 0);
+    assertEqual (test_SpinLattice2levelPacked() == 0);
+    assertEqual (test_Rng() == 0);
+    assertEqual (test_SweepKernels() == 0);
+    assertEqual (test_runningTotals() == 0);
+    assertEqual (test_WolffEngine() == 0);
+    assertEqual (test_SwendsenWang() == 0);
+    assertEqual (test_threadedLattice() == 0);
+    assertEqual (test_ThreadPool() == 0);
     assertEqual (test_Simulation_seq() == 0);
     assertEqual (test_Simulation_par() == 0);
+    assertEqual (test_Simulation_reproducible() == 0);
+    assertEqual (test_Simulation_chains() == 0);
+    assertEqual (test_Simulation_all() == 0);
+    assertEqual (test_Simulation_pt() == 0);
+    assertEqual (test_Simulation_status() == 0);
+    assertEqual (test_Simulation_summary() == 0);
+    assertEqual (test_JointHistogram() == 0);
+    assertEqual (test_BinningAnalysis() == 0);
+    assertEqual (test_autocorrelation() == 0);
+    assertEqual (test_MultiHistogram() == 0);
+    assertEqual (test_Resampling() == 0);
+    assertEqual (test_MeasurementWriter() == 0);
+    assertEqual (test_ResultFile() == 0);
+    assertEqual (test_TsvConverter() == 0);
 
     auto end = std::chrono::steady_clock::now();
     std::cout << "Time needed = " << std::chrono::duration_cast<std::chrono::seconds>(end - begin).count() << "[s]"
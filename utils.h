@@ -9,6 +9,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#include "Autocorrelation.h"
 #include "SpinLattice2level.h"
 
 /**
@@ -269,27 +270,31 @@ T stdev(const std::vector<T> &vec) {
 }
 
 /**
- * Calculates the autocorrelation-function of given data-sample
+ * Calculates the autocorrelation-function of given data-sample with the FFT, see autocorrelation
  * @tparam T
  * @param vec of data-sample with length n
  * @return autocorrelation-function in vector with length n/2
  */
 template<typename T>
 std::vector<T> autoCorr(const std::vector<T> &vec) {
-    float mean = std::accumulate(vec.begin(), vec.end(), 0.0f) / vec.size();
-
-    std::vector<float> autocorrelation(vec.size() / 2);
-    for (size_t t = 0; t < autocorrelation.size(); t++) {
-        float n = 0; // Numerator
-        float d = 0; // Denominator
-        for (size_t i = 0; i < vec.size() - t; i++) {
-            float xim = vec[i] - mean;
-            n += xim * (vec[(i + t) % vec.size()] - mean);
-            d += xim * xim;
-        }
-        autocorrelation[t] = n / d;
+    const std::vector<double> rho = autocorrelation(vec);
+    return std::vector<T>(rho.begin(), rho.end());
+}
+
+/**
+ * Calculates the autocorrelation-functions of many data-samples at once, in parallel, see autocorrelations
+ * @tparam T
+ * @param samples data-samples
+ * @return autocorrelation-function of every data-sample
+ */
+template<typename T>
+std::vector<std::vector<T>> autoCorr(const std::vector<std::vector<T>> &samples) {
+    std::vector<std::vector<T>> result;
+    result.reserve(samples.size());
+    for (const auto &rho : autocorrelations(samples)) {
+        result.emplace_back(rho.begin(), rho.end());
     }
-    return autocorrelation;
+    return result;
 }
 
 /**